@@ -18,4 +18,8 @@ trainModels(TrainDataStats);
 
 % Step 4: Evaluate all models using the Testing set
 fprintf('\n--- STEP 4: Evaluating Models ---\n');
-resultsTable = testModels(TestDataStats);
\ No newline at end of file
+resultsTable = testModels(TestDataStats);
+
+% Step 5: Export the bagged trees and neural networks for the Pico classifier
+fprintf('\n--- STEP 5: Exporting Model Weights ---\n');
+exportModelWeights(TestDataStats);
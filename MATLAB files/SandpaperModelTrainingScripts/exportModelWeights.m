@@ -0,0 +1,126 @@
+function exportModelWeights(TestDataStats)
+    % Exports the bagged trees and neural network models for the Pico classifier (Pico/imu_classifier.h).
+    % Writes Models/<name>.imumodel for Pico/host/classifier_bench, which checks the float32 and
+    % fixed-point versions and generates the firmware header. With test data, also writes
+    % Models/<name>_reference.csv: the 64 features, the true class and MATLAB's predicted class
+    % (0-based indices into ClassNames) for classifier_bench --reference.
+
+    fprintf('--- Exporting Model Weights ---\n');
+
+    if nargin < 1 && isfile('test_data.csv')
+        TestDataStats = readtable('test_data.csv', 'VariableNamingRule', 'preserve');
+    elseif nargin < 1
+        TestDataStats = [];
+    end
+
+    modelNames = {'BaggedTrees', 'MediumNN', 'WideNN'};
+    for i = 1:length(modelNames)
+        modelName = modelNames{i};
+        fullFilePath = fullfile('Models', ['Model_', modelName, '.mat']);
+        if ~isfile(fullFilePath)
+            warning('File %s not found in Models directory. Skipping...', fullFilePath);
+            continue;
+        end
+
+        % Same lookup as generateAllCCode.m.
+        loadedData = load(fullFilePath);
+        trainedModel = loadedData.trainedModel;
+        fields = fieldnames(trainedModel);
+        rawModel = [];
+        for f = 1:length(fields)
+            if contains(fields{f}, 'Classification')
+                rawModel = trainedModel.(fields{f});
+                break;
+            end
+        end
+        if isempty(rawModel)
+            warning('Could not find raw Classification model in %s. Skipping...', fullFilePath);
+            continue;
+        end
+
+        classNames = cellstr(rawModel.ClassNames);
+        predictorNames = rawModel.PredictorNames;
+        if numel(predictorNames) ~= 64
+            warning('%s has %d predictors, the Pico computes 64. Skipping...', modelName, numel(predictorNames));
+            continue;
+        end
+
+        isTrees = isprop(rawModel, 'Trained');
+        isNet = isprop(rawModel, 'LayerWeights');
+        if isTrees && ~strcmp(rawModel.Method, 'Bag')
+            warning('%s is a %s ensemble, only bagged trees are supported. Skipping...', modelName, rawModel.Method);
+            continue;
+        end
+        if ~isTrees && ~isNet
+            warning('%s is neither bagged trees nor a neural network. Skipping...', modelName);
+            continue;
+        end
+
+        % --- Header: magic, version, kind (1 trees, 2 net), features, classes, names ---
+        outPath = fullfile('Models', [modelName, '.imumodel']);
+        fid = fopen(outPath, 'w', 'ieee-le');
+        fwrite(fid, 'IMUM', 'char');
+        fwrite(fid, [1, 1 + isNet, 64, numel(classNames)], 'uint32');
+        for c = 1:numel(classNames)
+            nameBytes = zeros(1, 32, 'uint8');
+            bytes = uint8(classNames{c});
+            nameBytes(1:min(31, numel(bytes))) = bytes(1:min(31, numel(bytes)));
+            fwrite(fid, nameBytes, 'uint8');
+        end
+
+        if isTrees
+            % Nodes 0-based, leaves have feature -1. Go left when x < cut, like predict.
+            learners = rawModel.Trained;
+            fwrite(fid, numel(learners), 'uint32');
+            for t = 1:numel(learners)
+                tree = learners{t};
+                numNodes = numel(tree.CutPoint);
+                feature = -ones(numNodes, 1);
+                for node = find(tree.IsBranchNode)'
+                    feature(node) = find(strcmp(predictorNames, tree.CutPredictor{node})) - 1;
+                end
+                cut = tree.CutPoint;
+                cut(isnan(cut)) = 0;
+                children = max(tree.Children - 1, 0);
+                fwrite(fid, numNodes, 'uint32');
+                fwrite(fid, feature, 'int32');
+                fwrite(fid, cut, 'double');
+                fwrite(fid, children(:, 1), 'uint32');
+                fwrite(fid, children(:, 2), 'uint32');
+                fwrite(fid, tree.ClassProbability', 'double');
+            end
+        else
+            % Standardized inputs, ReLU hidden layers, softmax output. Weights row-major [out][in].
+            mu = rawModel.Mu;
+            sigma = rawModel.Sigma;
+            if isempty(mu)
+                mu = zeros(1, 64);
+                sigma = ones(1, 64);
+            end
+            fwrite(fid, mu, 'double');
+            fwrite(fid, sigma, 'double');
+            fwrite(fid, numel(rawModel.LayerWeights), 'uint32');
+            for l = 1:numel(rawModel.LayerWeights)
+                W = rawModel.LayerWeights{l};
+                fwrite(fid, [size(W, 1), size(W, 2)], 'uint32');
+                fwrite(fid, W', 'double');
+                fwrite(fid, rawModel.LayerBiases{l}, 'double');
+            end
+        end
+        fclose(fid);
+        fprintf('  -> %s written to %s\n', modelName, outPath);
+
+        % --- MATLAB's predictions for classifier_bench --reference ---
+        if ~isempty(TestDataStats)
+            X = TestDataStats{:, predictorNames};
+            [~, trueIndex] = ismember(cellstr(string(TestDataStats.Material)), classNames);
+            [~, predictedIndex] = ismember(cellstr(string(predict(rawModel, X))), classNames);
+            reference = array2table([X, trueIndex - 1, predictedIndex - 1], ...
+                'VariableNames', [predictorNames, {'true', 'predicted'}]);
+            referencePath = fullfile('Models', [modelName, '_reference.csv']);
+            writetable(reference, referencePath);
+            fprintf('  -> Reference predictions written to %s\n', referencePath);
+        end
+    end
+    fprintf('\n--- Export Complete ---\n');
+end
@@ -1,10 +1,47 @@
 #include <pico/stdlib.h>
 #include <stdio.h>
 #include <hardware/spi.h>
+#include <hardware/pwm.h>
+#include <hardware/clocks.h>
 #include <time.h>
 #include <inttypes.h>
 #include <pico/multicore.h>
-#include <pico/util/queue.h>
+
+#include "imu_core.h"
+#if IMU_USB_VENDOR
+#include "usb_stream.h"
+#endif
+#if IMU_CLASSIFIER
+#include "imu_classifier.h"
+#include IMU_MODEL_HEADER
+#endif
+
+// IMU settings, normally set from CMakeLists.txt. Defaults match the RaspPi recorder.
+#ifndef IMU_ODR_CODE
+#define IMU_ODR_CODE 4 // 4kHz.
+#endif
+#ifndef IMU_ACCEL_FS_CODE
+#define IMU_ACCEL_FS_CODE 0 // +-16g.
+#endif
+#ifndef IMU_GYRO_FS_CODE
+#define IMU_GYRO_FS_CODE 0 // +-2000dps.
+#endif
+#ifndef IMU_SPI_HZ
+#define IMU_SPI_HZ 1000000
+#endif
+#ifndef IMU_OVERFLOW_DROP
+#define IMU_OVERFLOW_DROP 0 // Stop the recording when the sample ring is full.
+#endif
+// Surface classification on core 1, see imu_classifier.h. 0 off, 1 float32, 2 fixed point.
+#ifndef IMU_CLASSIFIER
+#define IMU_CLASSIFIER 0
+#endif
+#ifndef IMU_CLASSIFIER_RAW
+#define IMU_CLASSIFIER_RAW 0 // Label records only, otherwise the samples followed by their labels.
+#endif
+#if IMU_CLASSIFIER && (IMU_ODR_CODE < 1 || IMU_ODR_CODE > 6)
+#error "The classifier needs an ODR that is a multiple of 1kHz, IMU_ODR_CODE 1 to 6"
+#endif
 
 enum
 {
@@ -42,8 +79,20 @@ enum
     kIntfConfig5 = 0x7b, // Note, this is in bank 1 , not bank 0.
     kAccelConfig0 = 0x50,
     kGyroConfig0 = 0x4f,
+    kIntStatus = 0x2D,
+    kFifoConfig = 0x16,
+    kFifoConfig1 = 0x5F,
+    kIntfConfig0 = 0x4C,
+    kSignalPathReset = 0x4B,
+    kTmstConfig = 0x54,
+
+    // CLKIN reference, see kClkinHz in imu_core.h.
+    kClkinPwmWrap = 3124, // 3125 counts, clk_sys / (32kHz * 3125) is an exact divider at 125MHz.
 };
 
+// Output data rate in Hz for each ODR code, 0 for reserved codes.
+static const uint kOdrHz[16] = {0, 32000, 16000, 8000, 4000, 2000, 1000, 200, 100, 50, 25, 12, 0, 0, 0, 500};
+
 #pragma region Function Definitions
 
 // One-time writes to IMU config-type registers.
@@ -65,58 +114,157 @@ void ImuInitRegisters()
     spi_out[0] = kPwrMgmt0;
     spi_out[1] = 0b00001111; // Place gyro and accel in low noise mode.
     spi_write_read_blocking(spi0, spi_out, in_buf, 2);
-    spi_out[0] = kIntfConfig1;
-    spi_out[1] = 0b10010001; // RTC clock input is NOT required.
-    spi_write_read_blocking(spi0, spi_out, in_buf, 2);
     spi_out[0] = kAccelConfig0;
-    spi_out[1] = 0b00000100; // Keep FS at +-16g, increase IMU freq from 1kHz to 4kHz.
+    spi_out[1] = (IMU_ACCEL_FS_CODE << 5) | IMU_ODR_CODE; // Accel FS and ODR.
     spi_write_read_blocking(spi0, spi_out, in_buf, 2);
     spi_out[0] = kGyroConfig0;
-    spi_out[1] = 0b01000110; // Change FS from +-2000dps to +-500dps.
+    spi_out[1] = (IMU_GYRO_FS_CODE << 5) | IMU_ODR_CODE; // Gyro FS and same ODR as accel.
+    spi_write_read_blocking(spi0, spi_out, in_buf, 2);
+    spi_out[0] = kIntfConfig0;
+    spi_out[1] = 0b01110000; // Count FIFO in records, keep big endian data.
+    spi_write_read_blocking(spi0, spi_out, in_buf, 2);
+    spi_out[0] = kTmstConfig;
+    spi_out[1] = 0b00101001; // Absolute timestamp, TMST_RES set so in RTC mode one tick is one CLKIN period.
+    spi_write_read_blocking(spi0, spi_out, in_buf, 2);
+    spi_out[0] = kFifoConfig1;
+    spi_out[1] = 0b00000111; // Accel, gyro, temperature and timestamp in the FIFO.
+    spi_write_read_blocking(spi0, spi_out, in_buf, 2);
+    spi_out[0] = kFifoConfig;
+    spi_out[1] = 0b01000000; // FIFO stream mode.
     spi_write_read_blocking(spi0, spi_out, in_buf, 2);
 
-    // Bank 1.
+    // Bank 1. Separate transfers, a single burst would auto-increment past REG_BANK_SEL.
     spi_out[0] = kRegBankSel;
     spi_out[1] = 0b00000001; // Change from bank 0 to bank 1.
-    spi_out[2] = kIntfConfig5;
-    spi_out[3] = 0b00000000; // Sets pin 9 function to Default (INT2).
-    spi_out[4] = kRegBankSel;
-    spi_out[5] = 0b00000000; // Change from bank 1 to bank 0.
-    spi_write_read_blocking(spi0, spi_out, in_buf, 6);
+    spi_write_read_blocking(spi0, spi_out, in_buf, 2);
+    spi_out[0] = kIntfConfig5;
+    spi_out[1] = 0b00000100; // Sets pin 9 function to CLKIN.
+    spi_write_read_blocking(spi0, spi_out, in_buf, 2);
+    spi_out[0] = kRegBankSel;
+    spi_out[1] = 0b00000000; // Change from bank 1 to bank 0.
+    spi_write_read_blocking(spi0, spi_out, in_buf, 2);
+
+    // RTC mode only once pin 9 is CLKIN, ODR and timestamps then run off it.
+    spi_out[0] = kIntfConfig1;
+    spi_out[1] = 0b10010101;
+    spi_write_read_blocking(spi0, spi_out, in_buf, 2);
 }
 
-#pragma endregion
+// Drive kImuClkinPin with a 32kHz square wave from a PWM slice. Must run before RTC mode is set.
+void ImuClkinInit()
+{
+    gpio_set_function(kImuClkinPin, GPIO_FUNC_PWM);
+    uint slice = pwm_gpio_to_slice_num(kImuClkinPin);
+    pwm_config config = pwm_get_default_config();
+    pwm_config_set_clkdiv(&config, (float)clock_get_hz(clk_sys) / ((float)kClkinHz * (kClkinPwmWrap + 1)));
+    pwm_config_set_wrap(&config, kClkinPwmWrap);
+    pwm_init(slice, &config, true);
+    pwm_set_gpio_level(kImuClkinPin, (kClkinPwmWrap + 1) / 2);
+}
 
-// Structs.
-typedef struct
+// Flush the IMU FIFO.
+void ImuFlushFifo()
 {
-    absolute_time_t t;
-    int16_t ax;
-    int16_t ay;
-    int16_t az;
-    int16_t gx;
-    int16_t gy;
-    int16_t gz;
-} ImuSample;
+    uint8_t spi_out[2] = {kSignalPathReset, 0b00000010}, spi_in[2];
+    spi_write_read_blocking(spi0, spi_out, spi_in, 2);
+}
+
+#pragma endregion
 
 // Global vars.
-queue_t gPrintfBuffer;
-const uint kMaxQueueSize = 5000; // How many ImuSample can be recorded at a time.
+enum
+{
+    kMaxQueueSize = 5000,   // How many ImuSample can be recorded at a time.
+    kCommandPollUs = 10000, // How often a recording looks for the stop command.
+};
+ImuSample gSampleSlots[kMaxQueueSize];
+SampleRing gSampleRing;
+ImuIngest gImuIngest; // gImuIngest.stats has the validity counters, sent as the trailer.
 bool gRecording = false;
+#if IMU_USB_VENDOR
+volatile bool gUsbMounted = false; // Written by core 1.
+volatile int gUsbCommand = -1;     // Last host command byte, written by core 1 and cleared by core 0.
+volatile bool gStatsPending = false; // Set by core 0 when a recording ends, core 1 prints the stats on CDC.
+#endif
+#if IMU_CLASSIFIER
+BatchClassifier gClassifier; // Owned by core 1.
+#endif
+
+#if IMU_CLASSIFIER
+void ClassifierInit()
+{
+#if IMU_CLASSIFIER == 2
+    BatchClassifierInit(&gClassifier, kOdrHz[IMU_ODR_CODE], NULL, &kClassifierModelQ, IMU_CLASSIFIER_RAW);
+#else
+    BatchClassifierInit(&gClassifier, kOdrHz[IMU_ODR_CODE], &kClassifierModel, NULL, IMU_CLASSIFIER_RAW);
+#endif
+}
+#endif
+
+// Pop the next batch into dst for the host. With the classifier, room is left for the labels and the
+// batch is classified in place. Returns bytes to send.
+size_t FrameBatch(void *dst, size_t space)
+{
+#if IMU_CLASSIFIER
+    size_t count = BatchClassifierPopLimit(&gClassifier, space / sizeof(ImuSample));
+    count = ImuFrameBatch(&gSampleRing, dst, count * sizeof(ImuSample)) / sizeof(ImuSample);
+    return BatchClassifierRun(&gClassifier, dst, count) * sizeof(ImuSample);
+#else
+    return ImuFrameBatch(&gSampleRing, dst, space);
+#endif
+}
+
+#if IMU_USB_VENDOR
+// Secondary core, owns USB. Samples are popped from the ring straight into the staging buffer.
+void secondary_core_main()
+{
+    UsbStreamInit();
+#if IMU_CLASSIFIER
+    ClassifierInit();
+#endif
+    while (true)
+    {
+        UsbStreamTask();
+        gUsbMounted = UsbStreamConnected();
+        int command = UsbStreamGetCommand();
+        if (command != -1)
+            gUsbCommand = command;
+        if (gStatsPending)
+        {
+            const ImuReadStats *stats = &gImuIngest.stats;
+            char line[160];
+            snprintf(line, sizeof(line),
+                     "stats samples=%lu empty=%lu duplicates=%lu invalid=%lu gaps=%lu overflows=%lu dropped=%lu\r\n",
+                     (unsigned long)stats->samples, (unsigned long)stats->empty, (unsigned long)stats->duplicates,
+                     (unsigned long)stats->invalid, (unsigned long)stats->gaps, (unsigned long)stats->overflows,
+                     (unsigned long)stats->dropped);
+            UsbCdcPuts(line);
+            gStatsPending = false;
+        }
 
+        size_t space;
+        uint8_t *staging = UsbStreamFillBuffer(&space);
+        UsbStreamCommit(FrameBatch(staging, space));
+    }
+}
+#else
 // Secondary core.
 void secondary_core_main()
 {
-    ImuSample data = {0};
+    // Static, a 48KB array does not fit on the core 1 stack.
+    static ImuSample fwrite_buffer[2000];
+#if IMU_CLASSIFIER
+    ClassifierInit();
+#endif
     while (true)
     {
         // Continue if buffer empty.
-        if (queue_get_level(&gPrintfBuffer) == 0)
+        if (SampleRingLevel(&gSampleRing) == 0)
             continue;
 
         // Blink task.
         // static absolute_time_t last_blink_u = 0;
-        // int blink_speed = 100 * queue_get_level(&gPrintfBuffer) / kMaxQueueSize + 1; // Value ranges 1-10.
+        // int blink_speed = 100 * SampleRingLevel(&gSampleRing) / kMaxQueueSize + 1; // Value ranges 1-10.
         // int blink_delay_u = 3000000 / blink_speed;
         // if (get_absolute_time() > last_blink_u + blink_delay_u)
         // {
@@ -127,16 +275,36 @@ void secondary_core_main()
         //     gpio_put(kLedPin, true);
 
         // Get a chunk of data.
-        const int fwrite_buff_size = 2000;
-        ImuSample fwrite_buffer[fwrite_buff_size];
-        int num_to_print = MIN(queue_get_level(&gPrintfBuffer), fwrite_buff_size);
-        for (size_t i = 0; i < num_to_print; i++)
-            queue_try_remove(&gPrintfBuffer, &fwrite_buffer[i]);
+        size_t num_bytes = FrameBatch(fwrite_buffer, sizeof(fwrite_buffer));
 
         // Print in binary format.
-        fwrite(&fwrite_buffer, sizeof(ImuSample), num_to_print, stdout);
+        fwrite(fwrite_buffer, 1, num_bytes, stdout);
     }
 }
+#endif
+
+// Next command byte from the host, -1 if none is waiting.
+int PollCommand()
+{
+#if IMU_USB_VENDOR
+    int command = gUsbCommand;
+    if (command != -1)
+        gUsbCommand = -1;
+    return command;
+#else
+    int command = getchar_timeout_us(0);
+    return command == PICO_ERROR_TIMEOUT ? -1 : command;
+#endif
+}
+
+// Block until the host sends a command byte.
+int WaitForCommand()
+{
+    int command;
+    while ((command = PollCommand()) == -1)
+        tight_loop_contents();
+    return command;
+}
 
 void main()
 {
@@ -146,6 +314,21 @@ void main()
         gpio_set_dir(kLedPin, GPIO_OUT);
     }
 
+    // Init sample ring. Before core 1 starts, it reads the ring.
+    {
+        SampleRingInit(&gSampleRing, gSampleSlots, kMaxQueueSize);
+    }
+
+#if IMU_USB_VENDOR
+    // USB is owned by core 1, wait for the host to configure the device.
+    {
+        multicore_launch_core1(secondary_core_main);
+        while (gUsbMounted == false)
+        {
+            sleep_ms(100);
+        }
+    }
+#else
     // Init debug printfs and gpios.
     if (true)
     {
@@ -170,6 +353,7 @@ void main()
     {
         printf("\033[2J\033[H");
     }
+#endif
 
     // Blinking and multicore safety sleep.
     for (int i = 0; i < 10; i++)
@@ -180,15 +364,12 @@ void main()
         sleep_ms(50);
     }
 
+#if !IMU_USB_VENDOR
     // Start second core.
     {
         multicore_launch_core1(secondary_core_main);
     }
-
-    // Init printf queue.
-    {
-        queue_init(&gPrintfBuffer, sizeof(ImuSample), kMaxQueueSize);
-    }
+#endif
 
     // Imu initialization.
     {
@@ -198,55 +379,77 @@ void main()
         gpio_disable_pulls(kImuInterruptPin);
         gpio_pull_up(kImuInterruptPin);
         // Imu Spibus init.
-        spi_init(spi0, 1 * 1000 * 1000);
+        spi_init(spi0, IMU_SPI_HZ);
         spi_set_format(spi0, 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
         gpio_set_function(kImuRxPin, GPIO_FUNC_SPI);
         gpio_set_function(kImuCsPin, GPIO_FUNC_SPI);
         gpio_set_function(kImuSckPin, GPIO_FUNC_SPI);
         gpio_set_function(kImuTxPin, GPIO_FUNC_SPI);
         gpio_disable_pulls(kImuRxPin);
+        // Imu reference clock, then registers.
+        ImuClkinInit();
         ImuInitRegisters();
     }
 
     while (true)
     {
         // Wait until user input 'r'.
-        if (getchar() != 'r')
+        if (WaitForCommand() != 'r')
         {
             continue;
         }
         gRecording = true;
         gpio_put(kLedPin, true);
 
-        absolute_time_t start_time = get_absolute_time();
+        // Start from an empty IMU FIFO.
+        ImuFlushFifo();
+        ImuIngestStart(&gImuIngest, &gSampleRing, kOdrHz[IMU_ODR_CODE], IMU_OVERFLOW_DROP ? kOverflowDrop : kOverflowStop);
 
-        // Main loop.
+        // Main loop, until the host sends 's' or the ring overflows.
+        uint32_t last_poll_us = time_us_32();
         while (true)
         {
-            // Wait until kImuInterruptPin pin is low.
-            if (gpio_get(kImuInterruptPin) == true)
+            // Wait until kImuInterruptPin pin is low, now and then checking for 's'. A FIFO backlog
+            // is read straight away, a missed edge must not leave a lag behind.
+            if (gpio_get(kImuInterruptPin) == true && gImuIngest.backlog == 0)
+            {
+                if (time_us_32() - last_poll_us > kCommandPollUs)
+                {
+                    last_poll_us = time_us_32();
+                    if (PollCommand() == 's')
+                        break;
+                }
                 continue;
+            }
 
-            // Record time (done right after Imu interrupt).
-            absolute_time_t curr_time = get_absolute_time() - start_time;
-
-            // Read from IMU.
-            uint8_t spi_out[13] = {0}, spi_in[13] = {0}; // 13 is enough to read all IMU data.
-            spi_out[0] = kAccelDataX0 | 0x80;
-            spi_write_read_blocking(spi0, spi_out, spi_in, 13);
-
-            // Parse IMU bits.
-            ImuSample data = {curr_time,
-                              (spi_in[1] << 8) + spi_in[2], (spi_in[3] << 8) + spi_in[4], (spi_in[5] << 8) + spi_in[6],
-                              (spi_in[7] << 8) + spi_in[8], (spi_in[9] << 8) + spi_in[10], (spi_in[11] << 8) + spi_in[12]};
+            // Read INT_STATUS, FIFO count and the FIFO packets in one transaction. Normally one packet,
+            // a backlog seen in the previous burst is popped as well.
+            const int num_packets = ImuIngestBurstPackets(&gImuIngest);
+            uint8_t spi_out[kFifoMaxBurstSize] = {0}, spi_in[kFifoMaxBurstSize] = {0};
+            spi_out[0] = kIntStatus | 0x80;
+            spi_write_read_blocking(spi0, spi_out, spi_in, kFifoBurstOverhead + kFifoPacketSize * num_packets);
 
             // Log IMU data.
-            if (queue_try_add(&gPrintfBuffer, &data) == false)
-            {
-                gRecording = false;
-                gpio_put(kLedPin, false);
+            ImuIngestResult result = ImuIngestBurst(&gImuIngest, spi_in, num_packets);
+            if (result == kIngestFlush)
+                ImuFlushFifo();
+            if (result == kIngestOverflow)
                 break; // If buffer full.
-            }
         }
+        gRecording = false;
+        gpio_put(kLedPin, false);
+
+        // Stats trailer after the last sample. A full ring drains as the host reads.
+        ImuSample trailer[kNumStatsRecords];
+        ImuStatsRecords(&gImuIngest.stats, trailer);
+        for (int i = 0; i < kNumStatsRecords; i++)
+        {
+            while (SampleRingPush(&gSampleRing, &trailer[i]) == false)
+                tight_loop_contents();
+        }
+#if IMU_USB_VENDOR
+        // Same counters as text on CDC, the stream itself is on the vendor endpoint.
+        gStatsPending = true;
+#endif
     }
 }
@@ -0,0 +1,1030 @@
+// Host benchmark and accuracy check of the core 1 classifier (imu_classifier.c) against the double
+// pipeline the models were trained on (RaspPi/imu_tools window_features.c, same numbers as processData.m).
+// Build with -DIMU_HOST_BUILD=ON.
+//
+//   classifier_bench MODEL.imumodel [--data DIR] [--reference CSV] [--header OUT.h] [--repeat N]
+//
+// MODEL comes from exportModelWeights.m. --data streams every recording in DIR through FeatureStream at
+// 1kHz and compares its features and predictions with the double pipeline on the same samples.
+// --reference checks all three models against MATLAB's own predictions (the _reference.csv written next
+// to the model). --header writes the float and fixed-point models as C arrays for IMU_MODEL_HEADER.
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "imu_classifier.h"
+#include "recording.h"
+#include "window_features.h"
+
+enum
+{
+    kModelVersion = 1,
+    kMaxFiles = 1024,
+    kClassNameSize = 32,
+    kBatchSamples = 2000, // Same as the CDC fwrite buffer.
+};
+
+// Model as exported, evaluated in double like MATLAB's predict.
+typedef struct
+{
+    uint32_t num_nodes;
+    int32_t *feature; // -1 for leaves.
+    double *cut;
+    uint32_t *left, *right;
+    double *prob; // [num_nodes][num_classes]
+} RefTree;
+
+typedef struct
+{
+    ModelKind kind;
+    int num_classes;
+    char class_names[kMaxClasses][kClassNameSize];
+    uint32_t num_trees;
+    RefTree *trees;
+    double mu[kNumFeatures], sigma[kNumFeatures];
+    int num_layers;
+    uint16_t layer_size[kMaxLayers + 1];
+    double *weights[kMaxLayers]; // [out][in]
+    double *biases[kMaxLayers];
+} RefModel;
+
+// float32 and fixed-point versions with the arrays they point to.
+typedef struct
+{
+    ClassifierModel model;
+    ClassifierModelQ model_q;
+    uint32_t num_nodes, num_leaves;
+    uint32_t *tree_start;
+    TreeNode *nodes;
+    TreeNodeQ *nodes_q;
+    float *leaf_scores;
+    uint16_t *leaf_scores_q;
+    float mu[kNumFeatures], inv_sigma[kNumFeatures];
+    float offset[kNumFeatures], scale[kNumFeatures];
+    uint32_t cut_start[kNumFeatures + 1];
+    float *cuts;
+    float *weights[kMaxLayers], *biases[kMaxLayers];
+    int16_t *weights_q[kMaxLayers];
+    int32_t *biases_q[kMaxLayers];
+} Models;
+
+// Predictions of one model variant.
+typedef struct
+{
+    uint64_t total;
+    uint64_t agree;   // Same class as the double model on the double features.
+    uint64_t correct; // Same class as the recording's label, when known.
+    uint64_t labeled;
+} Tally;
+
+typedef struct
+{
+    double ns;
+    uint64_t cycles;
+    uint64_t count;
+} Timer;
+
+static uint64_t NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Host cycles, 0 where there is no cheap counter.
+static uint64_t Cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static bool ReadAll(FILE *file, void *dst, size_t size)
+{
+    return fread(dst, 1, size, file) == size;
+}
+
+static bool ReadU32(FILE *file, uint32_t *value)
+{
+    return ReadAll(file, value, sizeof(*value));
+}
+
+// Little-endian layout written by exportModelWeights.m:
+//   "IMUM", u32 version, u32 kind, u32 num_features, u32 num_classes, char[32] class names,
+//   trees: u32 num_trees, per tree u32 num_nodes, i32 feature[n], f64 cut[n], u32 left[n], u32 right[n],
+//          f64 prob[n][classes]
+//   nets:  f64 mu[64], f64 sigma[64], u32 num_layers, per layer u32 out, u32 in, f64 w[out][in], f64 b[out]
+static int LoadModel(RefModel *model, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    memset(model, 0, sizeof(*model));
+    char magic[4];
+    uint32_t version, kind, num_features, num_classes;
+    bool ok = ReadAll(file, magic, 4) && memcmp(magic, "IMUM", 4) == 0 && ReadU32(file, &version) &&
+              version == kModelVersion && ReadU32(file, &kind) && ReadU32(file, &num_features) &&
+              num_features == kNumFeatures && ReadU32(file, &num_classes) && num_classes >= 2 &&
+              num_classes <= kMaxClasses;
+    if (ok)
+    {
+        model->kind = kind;
+        model->num_classes = num_classes;
+        for (uint32_t c = 0; c < num_classes && ok; c++)
+        {
+            ok = ReadAll(file, model->class_names[c], kClassNameSize);
+            model->class_names[c][kClassNameSize - 1] = '\0';
+        }
+    }
+
+    if (ok && kind == kModelTrees)
+    {
+        ok = ReadU32(file, &model->num_trees) && model->num_trees > 0 && model->num_trees <= UINT16_MAX;
+        if (ok)
+            model->trees = calloc(model->num_trees, sizeof(RefTree));
+        for (uint32_t t = 0; t < model->num_trees && ok; t++)
+        {
+            RefTree *tree = &model->trees[t];
+            ok = ReadU32(file, &tree->num_nodes) && tree->num_nodes > 0 && tree->num_nodes <= UINT16_MAX;
+            if (!ok)
+                break;
+            const uint32_t n = tree->num_nodes;
+            tree->feature = malloc(n * sizeof(int32_t));
+            tree->cut = malloc(n * sizeof(double));
+            tree->left = malloc(n * sizeof(uint32_t));
+            tree->right = malloc(n * sizeof(uint32_t));
+            tree->prob = malloc(n * num_classes * sizeof(double));
+            ok = ReadAll(file, tree->feature, n * sizeof(int32_t)) && ReadAll(file, tree->cut, n * sizeof(double)) &&
+                 ReadAll(file, tree->left, n * sizeof(uint32_t)) && ReadAll(file, tree->right, n * sizeof(uint32_t)) &&
+                 ReadAll(file, tree->prob, n * num_classes * sizeof(double));
+            for (uint32_t i = 0; i < n && ok; i++)
+            {
+                if (tree->feature[i] >= 0)
+                    ok = tree->feature[i] < kNumFeatures && tree->left[i] < n && tree->right[i] < n;
+            }
+        }
+    }
+    else if (ok && kind == kModelNet)
+    {
+        uint32_t num_layers;
+        ok = ReadAll(file, model->mu, sizeof(model->mu)) && ReadAll(file, model->sigma, sizeof(model->sigma)) &&
+             ReadU32(file, &num_layers) && num_layers >= 1 && num_layers <= kMaxLayers;
+        if (ok)
+            model->num_layers = num_layers;
+        model->layer_size[0] = kNumFeatures;
+        for (int l = 0; l < model->num_layers && ok; l++)
+        {
+            uint32_t out, in;
+            ok = ReadU32(file, &out) && ReadU32(file, &in) && in == model->layer_size[l] && out >= 1 &&
+                 out <= kMaxLayerSize;
+            if (!ok)
+                break;
+            model->layer_size[l + 1] = out;
+            model->weights[l] = malloc(out * in * sizeof(double));
+            model->biases[l] = malloc(out * sizeof(double));
+            ok = ReadAll(file, model->weights[l], out * in * sizeof(double)) &&
+                 ReadAll(file, model->biases[l], out * sizeof(double));
+        }
+        ok = ok && model->layer_size[model->num_layers] == num_classes;
+    }
+    else
+        ok = false;
+
+    fclose(file);
+    if (!ok)
+        fprintf(stderr, "%s: not a version %d model file or corrupt\n", path, kModelVersion);
+    return ok ? 0 : -1;
+}
+
+static int ArgMaxDouble(const double *x, int n)
+{
+    int best = 0;
+    for (int i = 1; i < n; i++)
+    {
+        if (x[i] > x[best])
+            best = i;
+    }
+    return best;
+}
+
+// MATLAB's predict: averaged leaf probabilities, or the standardized net with a softmax.
+static int RefPredict(const RefModel *model, const double *x, double *scores)
+{
+    double out[kMaxClasses] = {0};
+    if (model->kind == kModelTrees)
+    {
+        for (uint32_t t = 0; t < model->num_trees; t++)
+        {
+            const RefTree *tree = &model->trees[t];
+            uint32_t node = 0;
+            while (tree->feature[node] >= 0)
+                node = x[tree->feature[node]] < tree->cut[node] ? tree->left[node] : tree->right[node];
+            for (int c = 0; c < model->num_classes; c++)
+                out[c] += tree->prob[node * model->num_classes + c] / model->num_trees;
+        }
+    }
+    else
+    {
+        double a[kMaxLayerSize], z[kMaxLayerSize];
+        for (int i = 0; i < kNumFeatures; i++)
+            a[i] = model->sigma[i] > 0 ? (x[i] - model->mu[i]) / model->sigma[i] : x[i] - model->mu[i];
+        for (int l = 0; l < model->num_layers; l++)
+        {
+            const int in = model->layer_size[l];
+            for (int j = 0; j < model->layer_size[l + 1]; j++)
+            {
+                double acc = model->biases[l][j];
+                for (int i = 0; i < in; i++)
+                    acc += model->weights[l][j * in + i] * a[i];
+                z[j] = l == model->num_layers - 1 || acc > 0 ? acc : 0;
+            }
+            memcpy(a, z, model->layer_size[l + 1] * sizeof(double));
+        }
+        const int best = ArgMaxDouble(a, model->num_classes);
+        double total = 0;
+        for (int c = 0; c < model->num_classes; c++)
+            total += out[c] = exp(a[c] - a[best]);
+        for (int c = 0; c < model->num_classes; c++)
+            out[c] /= total;
+    }
+    if (scores != NULL)
+        memcpy(scores, out, model->num_classes * sizeof(double));
+    return ArgMaxDouble(out, model->num_classes);
+}
+
+// Largest shift in [0, 15] that keeps every int16 weight in range and every accumulator of the layer,
+// inputs at full scale plus the bias, inside int32.
+static int ChooseWeightShift(const double *w, const double *b, int num_out, int in, int input_q)
+{
+    for (int shift = 15; shift > 0; shift--)
+    {
+        bool fits = true;
+        for (int j = 0; j < num_out && fits; j++)
+        {
+            double worst = fabs(round(b[j] * ldexp(1, input_q + shift)));
+            for (int i = 0; i < in; i++)
+            {
+                const double q = fabs(round(w[j * in + i] * ldexp(1, shift)));
+                fits = fits && q <= 32767;
+                worst += q * 32768;
+            }
+            fits = fits && worst < 2147483647.0;
+        }
+        if (fits)
+            return shift;
+    }
+    return 0;
+}
+
+static int CompareFloats(const void *a, const void *b)
+{
+    const float fa = *(const float *)a, fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+// Index of cut among the sorted cuts of its feature.
+static uint32_t FindCut(const float *cuts, uint32_t num_cuts, float cut)
+{
+    const float *found = bsearch(&cut, cuts, num_cuts, sizeof(float), CompareFloats);
+    return (uint32_t)(found - cuts);
+}
+
+static void BuildModels(const RefModel *ref, Models *models)
+{
+    memset(models, 0, sizeof(*models));
+    ClassifierModel *model = &models->model;
+    ClassifierModelQ *model_q = &models->model_q;
+    model->kind = model_q->kind = ref->kind;
+    model->num_classes = model_q->num_classes = ref->num_classes;
+    model_q->offset = models->offset;
+    model_q->scale = models->scale;
+
+    if (ref->kind == kModelTrees)
+    {
+        // The float32 cuts of each feature, sorted and deduplicated. A node's threshold is its cut's
+        // index plus one, so rank < threshold is exactly x < cut for the float32 model.
+        uint32_t num_cuts[kNumFeatures] = {0}, num_splits = 0;
+        for (uint32_t t = 0; t < ref->num_trees; t++)
+        {
+            const RefTree *tree = &ref->trees[t];
+            models->num_nodes += tree->num_nodes;
+            for (uint32_t i = 0; i < tree->num_nodes; i++)
+            {
+                if (tree->feature[i] < 0)
+                    models->num_leaves++;
+                else
+                    num_cuts[tree->feature[i]]++;
+            }
+        }
+        for (int f = 0; f < kNumFeatures; f++)
+        {
+            models->cut_start[f + 1] = models->cut_start[f] + num_cuts[f];
+            num_splits += num_cuts[f];
+            num_cuts[f] = 0;
+        }
+        models->cuts = malloc((num_splits ? num_splits : 1) * sizeof(float));
+        for (uint32_t t = 0; t < ref->num_trees; t++)
+        {
+            const RefTree *tree = &ref->trees[t];
+            for (uint32_t i = 0; i < tree->num_nodes; i++)
+            {
+                const int f = tree->feature[i];
+                if (f >= 0)
+                    models->cuts[models->cut_start[f] + num_cuts[f]++] = (float)tree->cut[i];
+            }
+        }
+        uint32_t packed = 0;
+        for (int f = 0; f < kNumFeatures; f++)
+        {
+            float *cuts = &models->cuts[models->cut_start[f]];
+            qsort(cuts, num_cuts[f], sizeof(float), CompareFloats);
+            models->cut_start[f] = packed;
+            for (uint32_t i = 0; i < num_cuts[f]; i++)
+            {
+                if (i == 0 || cuts[i] != cuts[i - 1])
+                    models->cuts[packed++] = cuts[i];
+            }
+        }
+        models->cut_start[kNumFeatures] = packed;
+        model_q->cut_start = models->cut_start;
+        model_q->cuts = models->cuts;
+
+        models->tree_start = malloc(ref->num_trees * sizeof(uint32_t));
+        models->nodes = malloc(models->num_nodes * sizeof(TreeNode));
+        models->nodes_q = malloc(models->num_nodes * sizeof(TreeNodeQ));
+        models->leaf_scores = malloc(models->num_leaves * ref->num_classes * sizeof(float));
+        models->leaf_scores_q = malloc(models->num_leaves * ref->num_classes * sizeof(uint16_t));
+        uint32_t node = 0, leaf = 0;
+        for (uint32_t t = 0; t < ref->num_trees; t++)
+        {
+            const RefTree *tree = &ref->trees[t];
+            models->tree_start[t] = node;
+            for (uint32_t i = 0; i < tree->num_nodes; i++, node++)
+            {
+                const int f = tree->feature[i];
+                TreeNode *n = &models->nodes[node];
+                TreeNodeQ *nq = &models->nodes_q[node];
+                n->feature = nq->feature = (int16_t)f;
+                if (f < 0)
+                {
+                    n->left = nq->left = (uint16_t)leaf;
+                    n->right = nq->right = 0;
+                    n->threshold = 0;
+                    nq->threshold = 0;
+                    for (int c = 0; c < ref->num_classes; c++)
+                    {
+                        const double p = tree->prob[i * ref->num_classes + c];
+                        models->leaf_scores[leaf * ref->num_classes + c] = (float)p;
+                        models->leaf_scores_q[leaf * ref->num_classes + c] = (uint16_t)lrint(p * 32767);
+                    }
+                    leaf++;
+                    continue;
+                }
+                n->left = nq->left = (uint16_t)tree->left[i];
+                n->right = nq->right = (uint16_t)tree->right[i];
+                n->threshold = (float)tree->cut[i];
+                const uint32_t first = models->cut_start[f];
+                nq->threshold = (uint16_t)(FindCut(&models->cuts[first], models->cut_start[f + 1] - first, n->threshold) + 1);
+            }
+        }
+        model->num_trees = model_q->num_trees = ref->num_trees;
+        model->tree_start = model_q->tree_start = models->tree_start;
+        model->nodes = models->nodes;
+        model_q->nodes = models->nodes_q;
+        model->leaf_scores = models->leaf_scores;
+        model_q->leaf_scores = models->leaf_scores_q;
+        return;
+    }
+
+    for (int f = 0; f < kNumFeatures; f++)
+    {
+        models->mu[f] = models->offset[f] = (float)ref->mu[f];
+        models->inv_sigma[f] = ref->sigma[f] > 0 ? (float)(1 / ref->sigma[f]) : 1.0f;
+        models->scale[f] = ldexpf(models->inv_sigma[f], kInputQ);
+    }
+    model->mu = models->mu;
+    model->inv_sigma = models->inv_sigma;
+    model->num_layers = model_q->num_layers = ref->num_layers;
+    memcpy(model->layer_size, ref->layer_size, sizeof(ref->layer_size));
+    memcpy(model_q->layer_size, ref->layer_size, sizeof(ref->layer_size));
+    for (int l = 0; l < ref->num_layers; l++)
+    {
+        const int in = ref->layer_size[l], num_out = ref->layer_size[l + 1];
+        const int input_q = l == 0 ? kInputQ : kHiddenQ;
+        const int shift = ChooseWeightShift(ref->weights[l], ref->biases[l], num_out, in, input_q);
+        models->weights[l] = malloc(num_out * in * sizeof(float));
+        models->biases[l] = malloc(num_out * sizeof(float));
+        models->weights_q[l] = malloc(num_out * in * sizeof(int16_t));
+        models->biases_q[l] = malloc(num_out * sizeof(int32_t));
+        for (int i = 0; i < num_out * in; i++)
+        {
+            models->weights[l][i] = (float)ref->weights[l][i];
+            models->weights_q[l][i] = (int16_t)lrint(ref->weights[l][i] * ldexp(1, shift));
+        }
+        for (int j = 0; j < num_out; j++)
+        {
+            models->biases[l][j] = (float)ref->biases[l][j];
+            models->biases_q[l][j] = (int32_t)lrint(ref->biases[l][j] * ldexp(1, input_q + shift));
+        }
+        model->weights[l] = models->weights[l];
+        model->biases[l] = models->biases[l];
+        model_q->weights[l] = models->weights_q[l];
+        model_q->biases[l] = models->biases_q[l];
+        model_q->weight_shift[l] = (uint8_t)shift;
+    }
+}
+
+static void WriteFloats(FILE *out, const char *name, const float *x, size_t n)
+{
+    fprintf(out, "static const float %s[%zu] = {", name, n);
+    for (size_t i = 0; i < n; i++)
+        fprintf(out, "%s%.9g,", i % 8 == 0 ? "\n    " : " ", x[i]);
+    fprintf(out, "\n};\n");
+}
+
+// x holds n integers of size bytes.
+static void WriteInts(FILE *out, const char *type, const char *name, const void *x, size_t n, int size, bool is_signed)
+{
+    fprintf(out, "static const %s %s[%zu] = {", type, name, n);
+    for (size_t i = 0; i < n; i++)
+    {
+        long long v;
+        if (size == 2)
+            v = is_signed ? ((const int16_t *)x)[i] : ((const uint16_t *)x)[i];
+        else
+            v = is_signed ? ((const int32_t *)x)[i] : ((const uint32_t *)x)[i];
+        fprintf(out, "%s%lld,", i % 16 == 0 ? "\n    " : " ", v);
+    }
+    fprintf(out, "\n};\n");
+}
+
+static void WriteLayerSizes(FILE *out, const uint16_t *sizes, int num_layers)
+{
+    fprintf(out, "    .layer_size = {");
+    for (int l = 0; l <= num_layers; l++)
+        fprintf(out, "%s%u", l > 0 ? ", " : "", sizes[l]);
+    fprintf(out, "},\n");
+}
+
+// Both models as C arrays, the firmware build picks one. Unused arrays are dropped by the compiler.
+static int WriteHeader(const char *path, const char *model_path, const RefModel *ref, const Models *models)
+{
+    FILE *out = fopen(path, "w");
+    if (out == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    const int k = ref->num_classes;
+    fprintf(out, "// Generated by classifier_bench from %s, do not edit.\n#pragma once\n\n", model_path);
+    fprintf(out, "#include \"imu_classifier.h\"\n\n");
+    fprintf(out, "static const char *const kClassifierClassNames[%d] = {", k);
+    for (int c = 0; c < k; c++)
+        fprintf(out, "%s\"%s\"", c > 0 ? ", " : "", ref->class_names[c]);
+    fprintf(out, "};\n\n");
+
+    if (ref->kind == kModelTrees)
+    {
+        WriteInts(out, "uint32_t", "kTreeStart", models->tree_start, ref->num_trees, 4, false);
+        WriteInts(out, "uint32_t", "kTreeCutStart", models->cut_start, kNumFeatures + 1, 4, false);
+        WriteFloats(out, "kTreeCuts", models->cuts, models->cut_start[kNumFeatures]);
+        fprintf(out, "static const TreeNode kTreeNodes[%u] = {\n", models->num_nodes);
+        for (uint32_t i = 0; i < models->num_nodes; i++)
+        {
+            const TreeNode *n = &models->nodes[i];
+            fprintf(out, "    {%d, %u, %u, %.9g},\n", n->feature, n->left, n->right, n->threshold);
+        }
+        fprintf(out, "};\nstatic const TreeNodeQ kTreeNodesQ[%u] = {\n", models->num_nodes);
+        for (uint32_t i = 0; i < models->num_nodes; i++)
+        {
+            const TreeNodeQ *n = &models->nodes_q[i];
+            fprintf(out, "    {%d, %u, %u, %d},\n", n->feature, n->left, n->right, n->threshold);
+        }
+        fprintf(out, "};\n");
+        WriteFloats(out, "kLeafScores", models->leaf_scores, models->num_leaves * k);
+        WriteInts(out, "uint16_t", "kLeafScoresQ", models->leaf_scores_q, models->num_leaves * k, 2, false);
+
+        fprintf(out, "\nstatic const ClassifierModel kClassifierModel = {\n    .kind = kModelTrees,\n");
+        fprintf(out, "    .num_classes = %d,\n    .num_trees = %u,\n    .tree_start = kTreeStart,\n", k, ref->num_trees);
+        fprintf(out, "    .nodes = kTreeNodes,\n    .leaf_scores = kLeafScores,\n};\n");
+        fprintf(out, "\nstatic const ClassifierModelQ kClassifierModelQ = {\n    .kind = kModelTrees,\n");
+        fprintf(out, "    .num_classes = %d,\n    .num_trees = %u,\n    .tree_start = kTreeStart,\n", k, ref->num_trees);
+        fprintf(out, "    .nodes = kTreeNodesQ,\n    .leaf_scores = kLeafScoresQ,\n");
+        fprintf(out, "    .cut_start = kTreeCutStart,\n    .cuts = kTreeCuts,\n};\n");
+    }
+    else
+    {
+        char name[32];
+        WriteFloats(out, "kFeatureOffset", models->offset, kNumFeatures);
+        WriteFloats(out, "kFeatureScale", models->scale, kNumFeatures);
+        WriteFloats(out, "kNetMu", models->mu, kNumFeatures);
+        WriteFloats(out, "kNetInvSigma", models->inv_sigma, kNumFeatures);
+        for (int l = 0; l < ref->num_layers; l++)
+        {
+            const size_t size = (size_t)ref->layer_size[l] * ref->layer_size[l + 1];
+            snprintf(name, sizeof(name), "kNetWeights%d", l);
+            WriteFloats(out, name, models->weights[l], size);
+            snprintf(name, sizeof(name), "kNetBiases%d", l);
+            WriteFloats(out, name, models->biases[l], ref->layer_size[l + 1]);
+            snprintf(name, sizeof(name), "kNetWeightsQ%d", l);
+            WriteInts(out, "int16_t", name, models->weights_q[l], size, 2, true);
+            snprintf(name, sizeof(name), "kNetBiasesQ%d", l);
+            WriteInts(out, "int32_t", name, models->biases_q[l], ref->layer_size[l + 1], 4, true);
+        }
+
+        fprintf(out, "\nstatic const ClassifierModel kClassifierModel = {\n    .kind = kModelNet,\n");
+        fprintf(out, "    .num_classes = %d,\n    .mu = kNetMu,\n    .inv_sigma = kNetInvSigma,\n", k);
+        fprintf(out, "    .num_layers = %d,\n", ref->num_layers);
+        WriteLayerSizes(out, ref->layer_size, ref->num_layers);
+        fprintf(out, "    .weights = {");
+        for (int l = 0; l < ref->num_layers; l++)
+            fprintf(out, "%skNetWeights%d", l > 0 ? ", " : "", l);
+        fprintf(out, "},\n    .biases = {");
+        for (int l = 0; l < ref->num_layers; l++)
+            fprintf(out, "%skNetBiases%d", l > 0 ? ", " : "", l);
+        fprintf(out, "},\n};\n");
+
+        fprintf(out, "\nstatic const ClassifierModelQ kClassifierModelQ = {\n    .kind = kModelNet,\n");
+        fprintf(out, "    .num_classes = %d,\n    .offset = kFeatureOffset,\n    .scale = kFeatureScale,\n", k);
+        fprintf(out, "    .num_layers = %d,\n", ref->num_layers);
+        WriteLayerSizes(out, ref->layer_size, ref->num_layers);
+        fprintf(out, "    .weights = {");
+        for (int l = 0; l < ref->num_layers; l++)
+            fprintf(out, "%skNetWeightsQ%d", l > 0 ? ", " : "", l);
+        fprintf(out, "},\n    .biases = {");
+        for (int l = 0; l < ref->num_layers; l++)
+            fprintf(out, "%skNetBiasesQ%d", l > 0 ? ", " : "", l);
+        fprintf(out, "},\n    .weight_shift = {");
+        for (int l = 0; l < ref->num_layers; l++)
+            fprintf(out, "%s%u", l > 0 ? ", " : "", models->model_q.weight_shift[l]);
+        fprintf(out, "},\n};\n");
+    }
+    fclose(out);
+    return 0;
+}
+
+static void Count(Tally *tally, int predicted, int base, int label)
+{
+    tally->total++;
+    tally->agree += predicted == base;
+    if (label >= 0)
+    {
+        tally->labeled++;
+        tally->correct += predicted == label;
+    }
+}
+
+static void PrintTally(const char *name, const Tally *tally)
+{
+    printf("  %-28s agree %6.2f%%", name, tally->total ? 100.0 * tally->agree / tally->total : 0);
+    if (tally->labeled > 0)
+        printf("  accuracy %6.2f%%", 100.0 * tally->correct / tally->labeled);
+    printf("  (%llu windows)\n", (unsigned long long)tally->total);
+}
+
+static void PrintTimer(const char *name, const Timer *timer)
+{
+    if (timer->count == 0)
+        return;
+    printf("  %-28s %10.1f ns", name, timer->ns / timer->count);
+    if (timer->cycles > 0)
+        printf("  %10.0f cycles", (double)timer->cycles / timer->count);
+    printf("\n");
+}
+
+static int ClassIndex(const RefModel *model, const char *name)
+{
+    for (int c = 0; c < model->num_classes; c++)
+    {
+        if (strcmp(model->class_names[c], name) == 0)
+            return c;
+    }
+    return -1;
+}
+
+// Reference features from rows of 64 features, the true class and MATLAB's predicted class (0-based).
+static int RunReference(const RefModel *ref, const Models *models, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    Tally matlab = {0}, ref_tally = {0}, float_tally = {0}, fixed_tally = {0};
+    char line[8192];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        double x[kNumFeatures + 2];
+        char *p = line, *end;
+        int n = 0;
+        while (n < kNumFeatures + 2)
+        {
+            x[n] = strtod(p, &end);
+            if (end == p)
+                break;
+            n++;
+            p = end + strspn(end, ", \t");
+        }
+        if (n != kNumFeatures + 2)
+            continue; // Header.
+        float features[kNumFeatures];
+        for (int i = 0; i < kNumFeatures; i++)
+            features[i] = (float)x[i];
+        const int label = (int)x[kNumFeatures], matlab_class = (int)x[kNumFeatures + 1];
+        const int base = RefPredict(ref, x, NULL);
+        Count(&matlab, matlab_class, base, label);
+        Count(&ref_tally, base, matlab_class, label);
+        Count(&float_tally, ClassifierPredict(&models->model, features, NULL), matlab_class, label);
+        Count(&fixed_tally, ClassifierPredictQ(&models->model_q, features, NULL), matlab_class, label);
+    }
+    fclose(file);
+    printf("MATLAB reference %s, agreement with MATLAB's predictions\n", path);
+    PrintTally("MATLAB predict", &matlab);
+    PrintTally("double", &ref_tally);
+    PrintTally("float32", &float_tally);
+    PrintTally("fixed point", &fixed_tally);
+    return 0;
+}
+
+static int CompareStrings(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Per-feature error of the streamed features, relative to the spread of the reference feature.
+typedef struct
+{
+    double sum, sum_sq, err_sq, max_err;
+    uint64_t count;
+} FeatureError;
+
+// The firmware path over one recording: CDC sized batches through BatchClassifier, as core 1 pops them.
+// Returns the labels that differ from predicting the streamed features directly, -1 if the number of
+// labels differs.
+static long CheckBatches(const ImuSample *samples, size_t n, const ClassifierModel *model,
+                         const ClassifierModelQ *model_q, bool keep_samples,
+                         const float (*stream_features)[kNumFeatures], size_t num_stream)
+{
+    static ImuSample buffer[kBatchSamples];
+    static BatchClassifier classifier;
+    BatchClassifierInit(&classifier, kFeatureRateHz, model, model_q, keep_samples);
+    size_t next = 0, num_labels = 0, num_samples = 0;
+    long mismatches = 0;
+    while (next < n)
+    {
+        size_t count = BatchClassifierPopLimit(&classifier, kBatchSamples);
+        count = count < n - next ? count : n - next;
+        memcpy(buffer, &samples[next], count * sizeof(ImuSample));
+        next += count;
+        const size_t num_records = BatchClassifierRun(&classifier, buffer, count);
+        for (size_t i = 0; i < num_records; i++)
+        {
+            if ((buffer[i].t & kLabelRecordFlag) == 0)
+            {
+                num_samples++;
+                continue;
+            }
+            if (num_labels < num_stream)
+            {
+                const int expected = model != NULL ? ClassifierPredict(model, stream_features[num_labels], NULL)
+                                                   : ClassifierPredictQ(model_q, stream_features[num_labels], NULL);
+                mismatches += buffer[i].ax != expected;
+            }
+            num_labels++;
+        }
+    }
+    if (num_labels != num_stream || num_samples != (keep_samples ? n : 0))
+        return -1;
+    return mismatches;
+}
+
+static void RunData(const RefModel *ref, const Models *models, const char *dir_path, int repeat)
+{
+    DIR *dir = opendir(dir_path);
+    if (dir == NULL)
+    {
+        perror(dir_path);
+        return;
+    }
+    static char names[kMaxFiles][256];
+    char *sorted[kMaxFiles];
+    int num_files = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && num_files < kMaxFiles)
+    {
+        const size_t len = strlen(entry->d_name);
+        const bool csv = len >= 4 && strcmp(entry->d_name + len - 4, ".csv") == 0;
+        const bool bin = len >= 4 && strcmp(entry->d_name + len - 4, ".bin") == 0;
+        if ((!csv && !bin) || (len >= 13 && strcmp(entry->d_name + len - 13, "_episodes.csv") == 0))
+            continue;
+        snprintf(names[num_files], sizeof(names[0]), "%s", entry->d_name);
+        sorted[num_files] = names[num_files];
+        num_files++;
+    }
+    closedir(dir);
+    qsort(sorted, num_files, sizeof(char *), CompareStrings);
+
+    FeatureExtractor_t ext;
+    FeatureExtractorInit(&ext, &kDefaultFeatureParams);
+    static FeatureStream stream;
+    FeatureError errors[kNumFeatures] = {0};
+    Tally float_ref = {0}, fixed_ref = {0}, double_stream = {0}, float_stream = {0}, fixed_stream = {0};
+    Tally double_ref = {0};
+    int batch_errors = 0;
+    Timer push = {0}, extract = {0}, extract_double = {0}, predict_double = {0}, predict_float = {0},
+          predict_fixed = {0};
+
+    for (int f = 0; f < num_files; f++)
+    {
+        char path[512], class_name[64];
+        snprintf(path, sizeof(path), "%s/%s", dir_path, sorted[f]);
+        RecordingClassFromPath(sorted[f], class_name, sizeof(class_name));
+        const int label = ClassIndex(ref, class_name);
+        Recording_t rec;
+        if (RecordingLoad(&rec, path) != 0)
+            continue;
+
+        // Both pipelines see the same 1kHz int16 samples, the Pico's IMU delivers counts on that grid.
+        double *resampled[RECORDING_CHANNELS];
+        const size_t n = FeatureResample(&rec, &kDefaultFeatureParams, resampled);
+        RecordingFree(&rec);
+        if (n == 0)
+        {
+            printf("%s: too short\n", sorted[f]);
+            continue;
+        }
+        ImuSample *samples = malloc(n * sizeof(ImuSample));
+        Recording_t grid = {.num_samples = n, .num_columns = 1 + RECORDING_CHANNELS};
+        grid.t = malloc(n * sizeof(double));
+        for (int c = 0; c < RECORDING_CHANNELS; c++)
+            grid.ch[c] = malloc(n * sizeof(float));
+        for (size_t i = 0; i < n; i++)
+        {
+            int16_t v[RECORDING_CHANNELS];
+            for (int c = 0; c < RECORDING_CHANNELS; c++)
+            {
+                v[c] = (int16_t)fmax(-32768, fmin(32767, lrint(resampled[c][i])));
+                grid.ch[c][i] = v[c];
+            }
+            grid.t[i] = i / (double)kFeatureRateHz;
+            samples[i] = (ImuSample){i * (1000000 / kFeatureRateHz), v[0], v[1], v[2], v[3], v[4], v[5]};
+        }
+        for (int c = 0; c < RECORDING_CHANNELS; c++)
+            free(resampled[c]);
+
+        double *clean[RECORDING_CHANNELS];
+        float *ref_features = NULL;
+        size_t num_ref = 0;
+        const size_t num_clean = FeaturePreprocess(&grid, &kDefaultFeatureParams, clean);
+        RecordingFree(&grid);
+        if (num_clean > 0)
+        {
+            uint64_t start = NowNs(), start_cycles = Cycles();
+            num_ref = FeatureExtract(&ext, clean, num_clean, &ref_features);
+            extract_double.ns += NowNs() - start;
+            extract_double.cycles += Cycles() - start_cycles;
+            extract_double.count += num_ref;
+            for (int c = 0; c < RECORDING_CHANNELS; c++)
+                free(clean[c]);
+        }
+
+        // Stream, repeat times for the timings. Windows near the end are missing, movmean shrinks there.
+        float(*stream_features)[kNumFeatures] = malloc((num_ref + 1) * sizeof(*stream_features));
+        size_t num_stream = 0;
+        for (int r = 0; r < repeat; r++)
+        {
+            FeatureStreamInit(&stream, kFeatureRateHz);
+            num_stream = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                uint64_t start = NowNs(), start_cycles = Cycles();
+                const bool ready = FeatureStreamPush(&stream, &samples[i]);
+                push.cycles += Cycles() - start_cycles;
+                push.ns += NowNs() - start;
+                push.count++;
+                if (!ready || num_stream > num_ref)
+                    continue;
+                start = NowNs();
+                start_cycles = Cycles();
+                FeatureStreamExtract(&stream, stream_features[num_stream]);
+                extract.cycles += Cycles() - start_cycles;
+                extract.ns += NowNs() - start;
+                extract.count++;
+                num_stream++;
+            }
+        }
+        if (num_stream > num_ref)
+            num_stream = num_ref;
+        const long raw_float = CheckBatches(samples, n, &models->model, NULL, true, stream_features, num_stream);
+        const long labels_fixed = CheckBatches(samples, n, NULL, &models->model_q, false, stream_features, num_stream);
+        batch_errors += (raw_float != 0) + (labels_fixed != 0);
+        free(samples);
+
+        for (size_t w = 0; w < num_stream; w++)
+        {
+            const float *ref_w = &ref_features[w * kNumFeatures];
+            const float *stream_w = stream_features[w];
+            double x[kNumFeatures], xs[kNumFeatures];
+            for (int i = 0; i < kNumFeatures; i++)
+            {
+                x[i] = ref_w[i];
+                xs[i] = stream_w[i];
+                FeatureError *e = &errors[i];
+                const double err = fabs(xs[i] - x[i]);
+                e->sum += x[i];
+                e->sum_sq += x[i] * x[i];
+                e->err_sq += err * err;
+                e->max_err = fmax(e->max_err, err);
+                e->count++;
+            }
+
+            uint64_t start = NowNs(), start_cycles = Cycles();
+            const int base = RefPredict(ref, x, NULL);
+            predict_double.cycles += Cycles() - start_cycles;
+            predict_double.ns += NowNs() - start;
+            predict_double.count++;
+            Count(&double_ref, base, base, label);
+
+            start = NowNs();
+            start_cycles = Cycles();
+            const int float_class = ClassifierPredict(&models->model, ref_w, NULL);
+            predict_float.cycles += Cycles() - start_cycles;
+            predict_float.ns += NowNs() - start;
+            predict_float.count++;
+            Count(&float_ref, float_class, base, label);
+
+            start = NowNs();
+            start_cycles = Cycles();
+            const int fixed_class = ClassifierPredictQ(&models->model_q, ref_w, NULL);
+            predict_fixed.cycles += Cycles() - start_cycles;
+            predict_fixed.ns += NowNs() - start;
+            predict_fixed.count++;
+            Count(&fixed_ref, fixed_class, base, label);
+
+            Count(&double_stream, RefPredict(ref, xs, NULL), base, label);
+            Count(&float_stream, ClassifierPredict(&models->model, stream_w, NULL), base, label);
+            Count(&fixed_stream, ClassifierPredictQ(&models->model_q, stream_w, NULL), base, label);
+        }
+        printf("%s: %s, %zu windows, %zu streamed\n", sorted[f], class_name, num_ref, num_stream);
+        free(ref_features);
+        free(stream_features);
+    }
+    FeatureExtractorFree(&ext);
+
+    // Worst features first, error over the feature's standard deviation across windows.
+    char names_buf[kNumFeatures][24];
+    FeatureNames(names_buf);
+    double relative[kNumFeatures];
+    int order[kNumFeatures];
+    for (int i = 0; i < kNumFeatures; i++)
+    {
+        const FeatureError *e = &errors[i];
+        order[i] = i;
+        relative[i] = 0;
+        if (e->count < 2)
+            continue;
+        const double mean = e->sum / e->count;
+        const double spread = sqrt(fmax(e->sum_sq / e->count - mean * mean, 0));
+        const double rms_err = sqrt(e->err_sq / e->count);
+        relative[i] = spread > 0 ? rms_err / spread : rms_err;
+    }
+    for (int i = 0; i < kNumFeatures; i++)
+    {
+        for (int j = i + 1; j < kNumFeatures; j++)
+        {
+            if (relative[order[j]] > relative[order[i]])
+            {
+                const int swap = order[i];
+                order[i] = order[j];
+                order[j] = swap;
+            }
+        }
+    }
+    printf("\nstreamed features vs double, rms error / std across windows, worst 8\n");
+    for (int i = 0; i < 8; i++)
+    {
+        const FeatureError *e = &errors[order[i]];
+        printf("  %-22s %.2e  (max abs error %.3g)\n", names_buf[order[i]], relative[order[i]], e->max_err);
+    }
+    printf("\npredictions, agreement with the double model on double features\n");
+    PrintTally("double, double features", &double_ref);
+    PrintTally("float32, double features", &float_ref);
+    PrintTally("fixed point, double features", &fixed_ref);
+    PrintTally("double, streamed features", &double_stream);
+    PrintTally("float32, streamed features", &float_stream);
+    PrintTally("fixed point, streamed features", &fixed_stream);
+    printf("  firmware batches, raw+labels float32 and labels fixed point: %s\n",
+           batch_errors == 0 ? "same labels" : "MISMATCH");
+    printf("\nhost timings, per call\n");
+    PrintTimer("FeatureStreamPush", &push);
+    PrintTimer("FeatureStreamExtract", &extract);
+    PrintTimer("double FeatureExtract", &extract_double);
+    PrintTimer("double predict", &predict_double);
+    PrintTimer("ClassifierPredict", &predict_float);
+    PrintTimer("ClassifierPredictQ", &predict_fixed);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option kLongOptions[] = {
+        {"data", required_argument, NULL, 'd'},
+        {"reference", required_argument, NULL, 'r'},
+        {"header", required_argument, NULL, 'H'},
+        {"repeat", required_argument, NULL, 'n'},
+        {0},
+    };
+    static const char kUsage[] = "Usage: %s MODEL.imumodel [--data DIR] [--reference CSV] [--header OUT.h] [--repeat N]\n";
+    const char *data_dir = NULL, *reference_path = NULL, *header_path = NULL;
+    int repeat = 1;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:r:H:n:", kLongOptions, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            data_dir = optarg;
+            break;
+        case 'r':
+            reference_path = optarg;
+            break;
+        case 'H':
+            header_path = optarg;
+            break;
+        case 'n':
+            repeat = atoi(optarg) > 0 ? atoi(optarg) : 1;
+            break;
+        default:
+            fprintf(stderr, kUsage, argv[0]);
+            return 2;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        fprintf(stderr, kUsage, argv[0]);
+        return 2;
+    }
+    const char *model_path = argv[optind];
+
+    static RefModel ref;
+    if (LoadModel(&ref, model_path) != 0)
+        return 1;
+    static Models models;
+    BuildModels(&ref, &models);
+    if (models.num_leaves > UINT16_MAX)
+    {
+        fprintf(stderr, "%s: %u leaves, TreeNode can index %d\n", model_path, models.num_leaves, UINT16_MAX);
+        return 1;
+    }
+    for (int f = 0; ref.kind == kModelTrees && f < kNumFeatures; f++)
+    {
+        if (models.cut_start[f + 1] - models.cut_start[f] >= UINT16_MAX)
+        {
+            fprintf(stderr, "%s: feature %d has over %d distinct cuts, TreeNodeQ can't rank them\n", model_path, f,
+                    UINT16_MAX - 1);
+            return 1;
+        }
+    }
+    printf("%s: %s, %d classes", model_path, ref.kind == kModelTrees ? "bagged trees" : "neural net", ref.num_classes);
+    if (ref.kind == kModelTrees)
+        printf(", %u trees, %u nodes, %u leaves, %zu bytes float32, %zu bytes fixed point\n", ref.num_trees,
+               models.num_nodes, models.num_leaves,
+               models.num_nodes * sizeof(TreeNode) + models.num_leaves * ref.num_classes * sizeof(float),
+               models.num_nodes * sizeof(TreeNodeQ) + models.num_leaves * ref.num_classes * sizeof(uint16_t) +
+                   models.cut_start[kNumFeatures] * sizeof(float));
+    else
+    {
+        size_t num_weights = 0;
+        printf(", layers");
+        for (int l = 0; l < ref.num_layers; l++)
+        {
+            num_weights += (size_t)ref.layer_size[l + 1] * (ref.layer_size[l] + 1);
+            printf(" %u (shift %u)", ref.layer_size[l + 1], models.model_q.weight_shift[l]);
+        }
+        printf(", %zu weights\n", num_weights);
+    }
+
+    if (header_path != NULL && WriteHeader(header_path, model_path, &ref, &models) != 0)
+        return 1;
+    if (reference_path != NULL && RunReference(&ref, &models, reference_path) != 0)
+        return 1;
+    if (data_dir != NULL)
+        RunData(&ref, &models, data_dir, repeat);
+    return 0;
+}
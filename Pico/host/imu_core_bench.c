@@ -0,0 +1,278 @@
+// Host benchmark of the firmware core (imu_core.c): FIFO burst parsing, the inter-core ring and
+// batch framing. The IMU and SPI are replaced by a stub that synthesizes FIFO bursts, core 1 by a
+// thread running the same drain loop as the CDC build. Build with -DIMU_HOST_BUILD=ON.
+//
+//   imu_core_bench [--samples N] [--odr HZ] [--sink-us US] [--drop]
+//
+// Two runs: unpaced throughput with backpressure, then real time at ODR with the firmware's
+// overflow policy, reporting queue-to-drain latency.
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "imu_core.h"
+
+enum
+{
+    kMaxQueueSize = 5000, // Same as CollectImuData.c.
+    kDrainSamples = 2000, // Same as the CDC fwrite buffer.
+    kEmptyReadEvery = 1024,
+    kDuplicateEvery = 4099, // Not a multiple of kEmptyReadEvery.
+};
+
+typedef struct
+{
+    uint64_t num_samples;
+    uint32_t odr_hz;
+    uint32_t sink_us; // Extra time per drained batch, emulates a slow host.
+    ImuOverflowPolicy policy;
+} BenchConfig;
+
+typedef struct
+{
+    const BenchConfig *config;
+    SampleRing ring;
+    ImuIngest ingest;
+    uint64_t *queued_ns; // Time each sample was read, indexed by sample number.
+    atomic_bool producer_done;
+
+    // Written by the drain thread.
+    uint64_t drained;
+    uint64_t checksum;
+    uint32_t max_level;
+    uint32_t *latency_ns;
+    uint64_t num_latencies;
+} Bench;
+
+static uint64_t NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// SPI stub: the burst the IMU would return for sample n, with occasional empty reads and repeats.
+// Returns false if sample n was not delivered and has to be read again.
+static bool StubSpiReadBurst(uint8_t *burst, uint64_t n, uint64_t read_index, uint16_t period_ticks)
+{
+    bool delivered = true;
+    memset(burst, 0, kFifoBurstSize);
+    if (read_index % kEmptyReadEvery == kEmptyReadEvery - 1)
+        return false; // FIFO count 0.
+    if (read_index % kDuplicateEvery == kDuplicateEvery - 1 && n > 0)
+    {
+        n--;
+        delivered = false;
+    }
+
+    uint8_t *packet = &burst[kFifoBurstOverhead];
+    burst[3] = 1; // One record in the FIFO.
+    packet[0] = kFifoHeaderExpected;
+    for (int axis = 0; axis < 6; axis++)
+    {
+        uint16_t value = (uint16_t)(n * (axis + 1));
+        if (value == 0x8000)
+            value++; // Keep clear of the invalid-data marker.
+        packet[1 + 2 * axis] = value >> 8;
+        packet[2 + 2 * axis] = value & 0xFF;
+    }
+    uint16_t tmst = (uint16_t)(n * period_ticks);
+    packet[14] = tmst >> 8;
+    packet[15] = tmst & 0xFF;
+    return delivered;
+}
+
+// Multicore stub: the CDC secondary_core_main loop, with the fwrite replaced by a checksum.
+// Waits yield instead of spinning so the numbers stay meaningful when threads share a CPU.
+static void *DrainThread(void *arg)
+{
+    Bench *bench = arg;
+    static ImuSample buffer[kDrainSamples];
+    const uint64_t odr_hz = bench->config->odr_hz;
+    while (true)
+    {
+        uint32_t level = SampleRingLevel(&bench->ring);
+        if (level > bench->max_level)
+            bench->max_level = level;
+        if (level == 0)
+        {
+            if (atomic_load(&bench->producer_done) && SampleRingLevel(&bench->ring) == 0)
+                break;
+            sched_yield();
+            continue;
+        }
+
+        size_t num_bytes = ImuFrameBatch(&bench->ring, buffer, sizeof(buffer));
+        uint64_t now = NowNs();
+        for (size_t i = 0; i < num_bytes / sizeof(ImuSample); i++)
+        {
+            uint64_t n = (buffer[i].t * odr_hz + 999999) / 1000000; // t is rounded down to whole us.
+            bench->checksum += buffer[i].ax ^ buffer[i].gz;
+            if (bench->latency_ns != NULL)
+                bench->latency_ns[bench->num_latencies++] = (uint32_t)(now - bench->queued_ns[n]);
+        }
+        bench->drained += num_bytes / sizeof(ImuSample);
+
+        if (bench->config->sink_us > 0)
+        {
+            uint64_t until = NowNs() + bench->config->sink_us * 1000ull;
+            while (NowNs() < until)
+                ;
+        }
+    }
+    return NULL;
+}
+
+static int CompareU32(const void *a, const void *b)
+{
+    uint32_t ua = *(const uint32_t *)a, ub = *(const uint32_t *)b;
+    return (ua > ub) - (ua < ub);
+}
+
+static void PrintStats(const Bench *bench)
+{
+    const ImuReadStats *stats = &bench->ingest.stats;
+    printf("  samples %u  empty %u  duplicates %u  gaps %u  dropped %u  drained %llu  max ring level %u/%d\n",
+           stats->samples, stats->empty, stats->duplicates, stats->gaps, stats->dropped,
+           (unsigned long long)bench->drained, bench->max_level, kMaxQueueSize - 1);
+}
+
+// GPIO stub: paced runs busy wait for each sample's data-ready time, like the firmware polls the pin.
+static void RunBench(const BenchConfig *config, bool paced)
+{
+    static ImuSample slots[kMaxQueueSize];
+    Bench bench = {.config = config};
+    SampleRingInit(&bench.ring, slots, kMaxQueueSize);
+    ImuIngestStart(&bench.ingest, &bench.ring, config->odr_hz, paced ? config->policy : kOverflowStop);
+    bench.queued_ns = calloc(config->num_samples, sizeof(uint64_t));
+    if (paced)
+        bench.latency_ns = malloc(config->num_samples * sizeof(uint32_t));
+
+    pthread_t drain;
+    pthread_create(&drain, NULL, DrainThread, &bench);
+
+    const uint16_t period_ticks = kClkinHz / config->odr_hz;
+    const uint64_t period_ns = 1000000000ull / config->odr_hz;
+    uint64_t worst_ingest_ns = 0;
+    bool stopped = false;
+    uint8_t burst[kFifoBurstSize];
+    const uint64_t start = NowNs();
+    uint64_t n = 0, reads = 0;
+    while (n < config->num_samples)
+    {
+        if (paced)
+        {
+            while (NowNs() < start + n * period_ns)
+                sched_yield();
+        }
+        else
+        {
+            // Backpressure instead of an overflow, this run measures the pipeline's ceiling.
+            while (SampleRingLevel(&bench.ring) >= kMaxQueueSize - 1)
+                sched_yield();
+        }
+
+        bool delivered = StubSpiReadBurst(burst, n, reads++, period_ticks);
+        uint64_t before = NowNs();
+        bench.queued_ns[n] = before;
+        ImuIngestResult result = ImuIngestBurst(&bench.ingest, burst, 1);
+        uint64_t ingest_ns = NowNs() - before;
+        if (ingest_ns > worst_ingest_ns)
+            worst_ingest_ns = ingest_ns;
+
+        if (result == kIngestOverflow)
+        {
+            stopped = true;
+            break;
+        }
+        if (delivered)
+            n++;
+    }
+    atomic_store(&bench.producer_done, true);
+    pthread_join(drain, NULL);
+    const double elapsed_s = (NowNs() - start) / 1e9;
+
+    if (paced)
+    {
+        printf("real time at %u Hz, %s on overflow, sink %u us per batch\n", config->odr_hz,
+               config->policy == kOverflowDrop ? "drop" : "stop", config->sink_us);
+        PrintStats(&bench);
+        if (stopped)
+            printf("  ring overflowed after %llu samples, recording stopped\n", (unsigned long long)n);
+        if (bench.num_latencies > 0)
+        {
+            qsort(bench.latency_ns, bench.num_latencies, sizeof(uint32_t), CompareU32);
+            printf("  queue to drain latency (us)  p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+                   bench.latency_ns[bench.num_latencies / 2] / 1e3,
+                   bench.latency_ns[(uint64_t)(bench.num_latencies * 0.99)] / 1e3,
+                   bench.latency_ns[(uint64_t)(bench.num_latencies * 0.999)] / 1e3,
+                   bench.latency_ns[bench.num_latencies - 1] / 1e3);
+        }
+        printf("  worst ingest call %.2f us\n", worst_ingest_ns / 1e3);
+    }
+    else
+    {
+        printf("throughput, unpaced\n");
+        PrintStats(&bench);
+        printf("  %.1f M samples/s  %.1f ns/sample  %.1f MB/s framed  worst ingest call %.2f us\n",
+               bench.drained / elapsed_s / 1e6, elapsed_s * 1e9 / bench.drained,
+               bench.drained * sizeof(ImuSample) / elapsed_s / 1e6, worst_ingest_ns / 1e3);
+    }
+    if (bench.checksum == 1)
+        printf("\n"); // Keeps the drain work from being optimized out.
+
+    free(bench.queued_ns);
+    free(bench.latency_ns);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option kLongOptions[] = {
+        {"samples", required_argument, NULL, 'n'},
+        {"odr", required_argument, NULL, 'o'},
+        {"sink-us", required_argument, NULL, 's'},
+        {"drop", no_argument, NULL, 'd'},
+        {0},
+    };
+    BenchConfig config = {.num_samples = 2000000, .odr_hz = 32000, .sink_us = 0, .policy = kOverflowStop};
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:o:s:d", kLongOptions, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            config.num_samples = strtoull(optarg, NULL, 10);
+            break;
+        case 'o':
+            config.odr_hz = atoi(optarg);
+            break;
+        case 's':
+            config.sink_us = atoi(optarg);
+            break;
+        case 'd':
+            config.policy = kOverflowDrop;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [--samples N] [--odr HZ] [--sink-us US] [--drop]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (config.odr_hz == 0 || kClkinHz % config.odr_hz != 0)
+    {
+        fprintf(stderr, "ODR must divide %d Hz\n", kClkinHz);
+        return 1;
+    }
+
+    RunBench(&config, false);
+    RunBench(&config, true);
+    return 0;
+}
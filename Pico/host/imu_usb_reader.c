@@ -0,0 +1,355 @@
+// Host side reader for the Pico sample stream. Measures sustained throughput and latency
+// for both transports so the vendor bulk path can be compared against stdio over CDC.
+//
+//   imu_usb_reader [--cdc /dev/ttyACM0] [--seconds N] [--out samples.bin]
+//
+// Without --cdc the IMU_USB_VENDOR build is opened through libusb. Sends 'r', reads for N seconds,
+// then sends 's' and prints the validity counters from the Pico's stats trailer.
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <libusb.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// Must match ImuSample in CollectImuData.c.
+typedef struct
+{
+    uint64_t t; // Microseconds since recording start, from the IMU timestamp.
+    int16_t ax, ay, az, gx, gy, gz;
+} ImuSample;
+
+enum
+{
+    kVid = 0xCAFE,
+    kPid = 0x4010,
+    kVendorInterface = 2,
+    kEpVendorOut = 0x03,
+    kEpVendorIn = 0x83,
+    kTransferSize = 16384,
+    kNumTransfers = 4, // Kept in flight so the host always has an IN token pending.
+    kMaxLatencySamples = 1 << 20,
+    kMaxLabelClasses = 8, // Same as kMaxClasses in imu_classifier.h.
+    kStopWaitS = 1,       // How long to wait for the stats trailer after sending 's'.
+};
+
+// Stats trailer that ends a recording, must match ImuReadStats and kStatsRecordFlag in imu_core.h.
+static const uint64_t kStatsRecordFlag = 3ull << 62;
+static const char *const kStatsNames[] = {"samples", "empty", "duplicates", "invalid", "gaps", "overflows", "dropped"};
+enum
+{
+    kNumStats = sizeof(kStatsNames) / sizeof(kStatsNames[0]),
+};
+
+// Receive state shared by both transports.
+typedef struct
+{
+    FILE *out;
+    uint8_t partial[sizeof(ImuSample)];
+    size_t partial_len;
+    uint64_t bytes, samples, gaps;
+    uint64_t labels[kMaxLabelClasses]; // Label records per class.
+    uint32_t stats[kNumStats];         // Pico counters from the trailer.
+    int num_stats;                     // Trailer records received, kNumStats once complete.
+    uint64_t prev_t;
+    int64_t period_us; // 0 until the first interval of the current recording.
+    bool have_prev;
+    double start_s, stop_s;            // Stop is when 's' was sent, the trailer comes after.
+    // Arrival time minus sample time for the newest sample of every chunk.
+    double min_offset_us;
+    double *offsets_us;
+    int num_offsets;
+} Receiver;
+
+static volatile bool gStop = false;
+
+static double NowSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void Consume(Receiver *rx, const uint8_t *data, size_t len)
+{
+    const double arrival_us = (NowSeconds() - rx->start_s) * 1e6;
+    rx->bytes += len;
+    if (rx->out != NULL)
+        fwrite(data, 1, len, rx->out);
+
+    // Reassemble samples split across chunks.
+    ImuSample newest;
+    bool have_newest = false;
+    while (len > 0)
+    {
+        size_t take = sizeof(ImuSample) - rx->partial_len;
+        if (take > len)
+            take = len;
+        memcpy(rx->partial + rx->partial_len, data, take);
+        rx->partial_len += take;
+        data += take;
+        len -= take;
+        if (rx->partial_len < sizeof(ImuSample))
+            break;
+        rx->partial_len = 0;
+
+        ImuSample record;
+        memcpy(&record, rx->partial, sizeof(record));
+        // Label records from an IMU_CLASSIFIER build have bit 63 of t set, ax is the class. The
+        // stats trailer also sets bit 62. Neither carries a sample time, so only samples become newest.
+        if ((record.t & kStatsRecordFlag) == kStatsRecordFlag)
+        {
+            const uint64_t index = record.t & ~kStatsRecordFlag;
+            if (index < kNumStats)
+            {
+                rx->stats[index] = (uint16_t)record.ax | (uint32_t)(uint16_t)record.ay << 16;
+                rx->num_stats++;
+            }
+            continue;
+        }
+        if (record.t >> 63)
+        {
+            rx->labels[record.ax & (kMaxLabelClasses - 1)]++;
+            continue;
+        }
+        newest = record;
+        // The first interval of a recording sets the nominal period, anything over 1.5 periods is a
+        // gap. t going backwards is a new recording or a Pico reset, the period is measured again.
+        const int64_t step = (int64_t)(newest.t - rx->prev_t);
+        if (rx->have_prev && step < 0)
+            rx->period_us = 0;
+        else if (rx->have_prev && rx->period_us == 0)
+            rx->period_us = step;
+        else if (rx->have_prev && 2 * step > 3 * rx->period_us)
+            rx->gaps++;
+        rx->prev_t = newest.t;
+        rx->have_prev = true;
+        rx->samples++;
+        have_newest = true;
+    }
+
+    if (have_newest && rx->num_offsets < kMaxLatencySamples)
+    {
+        double offset = arrival_us - (double)newest.t;
+        if (rx->num_offsets == 0 || offset < rx->min_offset_us)
+            rx->min_offset_us = offset;
+        rx->offsets_us[rx->num_offsets++] = offset;
+    }
+}
+
+static int CompareDoubles(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+static void Report(Receiver *rx, const char *transport)
+{
+    double elapsed = (rx->stop_s > 0 ? rx->stop_s : NowSeconds()) - rx->start_s;
+    printf("transport      %s\n", transport);
+    printf("duration       %.2f s\n", elapsed);
+    printf("bytes          %llu (%.3f MB/s)\n", (unsigned long long)rx->bytes, rx->bytes / elapsed / 1e6);
+    printf("samples        %llu (%.0f samples/s)\n", (unsigned long long)rx->samples, rx->samples / elapsed);
+    printf("gaps           %llu\n", (unsigned long long)rx->gaps);
+    for (int c = 0; c < kMaxLabelClasses; c++)
+    {
+        if (rx->labels[c] > 0)
+            printf("labels class %d %llu\n", c, (unsigned long long)rx->labels[c]);
+    }
+    if (rx->num_stats >= kNumStats)
+    {
+        printf("pico stats    ");
+        for (int i = 0; i < kNumStats; i++)
+            printf(" %s %u", kStatsNames[i], rx->stats[i]);
+        printf("\n");
+    }
+    else
+        printf("pico stats     no trailer received\n");
+
+    // Latency above the best case seen, i.e. buffering and transport delay added per chunk.
+    if (rx->num_offsets > 0)
+    {
+        for (int i = 0; i < rx->num_offsets; i++)
+            rx->offsets_us[i] -= rx->min_offset_us;
+        qsort(rx->offsets_us, rx->num_offsets, sizeof(double), CompareDoubles);
+        printf("latency (us)   p50 %.0f  p99 %.0f  max %.0f  over %d chunks\n",
+               rx->offsets_us[rx->num_offsets / 2],
+               rx->offsets_us[(int)(rx->num_offsets * 0.99)],
+               rx->offsets_us[rx->num_offsets - 1],
+               rx->num_offsets);
+    }
+}
+
+static void LIBUSB_CALL TransferDone(struct libusb_transfer *transfer)
+{
+    Receiver *rx = transfer->user_data;
+    if (transfer->status == LIBUSB_TRANSFER_COMPLETED)
+        Consume(rx, transfer->buffer, transfer->actual_length);
+    else if (transfer->status != LIBUSB_TRANSFER_TIMED_OUT)
+        gStop = true;
+    if (gStop == false && libusb_submit_transfer(transfer) != 0)
+        gStop = true;
+}
+
+static int RunVendor(Receiver *rx, double seconds)
+{
+    libusb_context *ctx;
+    if (libusb_init(&ctx) != 0)
+        return 1;
+    libusb_device_handle *dev = libusb_open_device_with_vid_pid(ctx, kVid, kPid);
+    if (dev == NULL || libusb_claim_interface(dev, kVendorInterface) != 0)
+    {
+        fprintf(stderr, "Could not open %04x:%04x, is an IMU_USB_VENDOR build connected?\n", kVid, kPid);
+        libusb_exit(ctx);
+        return 1;
+    }
+
+    struct libusb_transfer *transfers[kNumTransfers];
+    for (int i = 0; i < kNumTransfers; i++)
+    {
+        transfers[i] = libusb_alloc_transfer(0);
+        libusb_fill_bulk_transfer(transfers[i], dev, kEpVendorIn, malloc(kTransferSize), kTransferSize,
+                                  TransferDone, rx, 1000);
+        libusb_submit_transfer(transfers[i]);
+    }
+
+    // Start recording.
+    unsigned char command = 'r';
+    int sent;
+    libusb_bulk_transfer(dev, kEpVendorOut, &command, 1, &sent, 1000);
+    rx->start_s = NowSeconds();
+
+    while (gStop == false && NowSeconds() - rx->start_s < seconds)
+    {
+        struct timeval tv = {0, 100000};
+        libusb_handle_events_timeout(ctx, &tv);
+    }
+
+    // Stop recording and keep reading until the stats trailer is in.
+    command = 's';
+    rx->stop_s = NowSeconds();
+    libusb_bulk_transfer(dev, kEpVendorOut, &command, 1, &sent, 1000);
+    while (gStop == false && rx->num_stats < kNumStats && NowSeconds() - rx->stop_s < kStopWaitS)
+    {
+        struct timeval tv = {0, 100000};
+        libusb_handle_events_timeout(ctx, &tv);
+    }
+
+    gStop = true;
+    for (int i = 0; i < kNumTransfers; i++)
+        libusb_cancel_transfer(transfers[i]);
+    struct timeval tv = {0, 200000};
+    libusb_handle_events_timeout(ctx, &tv);
+    Report(rx, "vendor bulk");
+
+    for (int i = 0; i < kNumTransfers; i++)
+    {
+        free(transfers[i]->buffer);
+        libusb_free_transfer(transfers[i]);
+    }
+    libusb_release_interface(dev, kVendorInterface);
+    libusb_close(dev);
+    libusb_exit(ctx);
+    return 0;
+}
+
+static int RunCdc(Receiver *rx, const char *device, double seconds)
+{
+    int fd = open(device, O_RDWR | O_NOCTTY);
+    if (fd < 0)
+    {
+        perror("Could not open CDC device");
+        return 1;
+    }
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 1;
+    tcsetattr(fd, TCSANOW, &tio);
+    tcflush(fd, TCIOFLUSH);
+
+    // Start recording.
+    if (write(fd, "r", 1) != 1)
+        perror("Could not send start command");
+    rx->start_s = NowSeconds();
+
+    static uint8_t buffer[kTransferSize];
+    while (NowSeconds() - rx->start_s < seconds)
+    {
+        ssize_t len = read(fd, buffer, sizeof(buffer));
+        if (len < 0)
+            break;
+        if (len > 0)
+            Consume(rx, buffer, len);
+    }
+
+    // Stop recording and keep reading until the stats trailer is in.
+    rx->stop_s = NowSeconds();
+    if (write(fd, "s", 1) != 1)
+        perror("Could not send stop command");
+    while (rx->num_stats < kNumStats && NowSeconds() - rx->stop_s < kStopWaitS)
+    {
+        ssize_t len = read(fd, buffer, sizeof(buffer));
+        if (len < 0)
+            break;
+        if (len > 0)
+            Consume(rx, buffer, len);
+    }
+    Report(rx, "stdio over CDC");
+    close(fd);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option kLongOptions[] = {
+        {"cdc", required_argument, NULL, 'c'},
+        {"seconds", required_argument, NULL, 's'},
+        {"out", required_argument, NULL, 'o'},
+        {0},
+    };
+    const char *cdc_device = NULL, *out_path = NULL;
+    double seconds = 10;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "c:s:o:", kLongOptions, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            cdc_device = optarg;
+            break;
+        case 's':
+            seconds = atof(optarg);
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [--cdc DEVICE] [--seconds N] [--out FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Receiver rx = {0};
+    rx.offsets_us = malloc(sizeof(double) * kMaxLatencySamples);
+    if (out_path != NULL && (rx.out = fopen(out_path, "wb")) == NULL)
+    {
+        perror("Could not open output file");
+        return 1;
+    }
+
+    int ret = cdc_device != NULL ? RunCdc(&rx, cdc_device, seconds) : RunVendor(&rx, seconds);
+
+    if (rx.out != NULL)
+        fclose(rx.out);
+    free(rx.offsets_us);
+    return ret;
+}
@@ -0,0 +1,564 @@
+#include "imu_classifier.h"
+
+#include <math.h>
+#include <string.h>
+
+enum
+{
+    kFftStages = 5,
+    kSignalLimit = 32000, // Largest FFT input, leaves room for rounding growth across the stages.
+    kLog2TableBits = 8,
+    kLog2One = 1 << 16, // Q16.
+
+    // Radix-5 butterfly coefficients over 5 in Q15: 1, cos(2 pi / 5), cos(4 pi / 5), sin(2 pi / 5), sin(4 pi / 5).
+    kFifthQ15 = 6553,
+    kCos1Q15 = 2025,
+    kCos2Q15 = -5302,
+    kSin1Q15 = 6233,
+    kSin2Q15 = 3852,
+};
+
+// 200 = 2 * 2 * 2 * 5 * 5.
+static const uint8_t kFftRadix[kFftStages] = {2, 2, 2, 5, 5};
+
+// Q15 twiddles exp(-2 pi i k / kFeatureWindow). Every stage divides by its radix so the FFT output is
+// X / kFeatureWindow, P1 without the doubling.
+static int16_t gTwiddleRe[kFeatureWindow], gTwiddleIm[kFeatureWindow];
+// log2(1 + i / 256) in Q16, one extra entry for the interpolation.
+static uint32_t gLog2Table[(1 << kLog2TableBits) + 1];
+static bool gTablesReady = false;
+
+static void InitTables()
+{
+    if (gTablesReady)
+        return;
+    const double two_pi = 6.283185307179586;
+    for (int k = 0; k < kFeatureWindow; k++)
+    {
+        gTwiddleRe[k] = (int16_t)lrint(32767 * cos(two_pi * k / kFeatureWindow));
+        gTwiddleIm[k] = (int16_t)lrint(-32767 * sin(two_pi * k / kFeatureWindow));
+    }
+    for (int i = 0; i <= 1 << kLog2TableBits; i++)
+        gLog2Table[i] = (uint32_t)lrint(kLog2One * log2(1 + (double)i / (1 << kLog2TableBits)));
+    gTablesReady = true;
+}
+
+bool FeatureStreamInit(FeatureStream *stream, uint32_t odr_hz)
+{
+    if (odr_hz == 0 || odr_hz % kFeatureRateHz != 0)
+        return false;
+    InitTables();
+    memset(stream, 0, sizeof(*stream));
+    stream->decimation = odr_hz / kFeatureRateHz;
+    return true;
+}
+
+bool FeatureStreamPush(FeatureStream *stream, const ImuSample *sample)
+{
+    // interp1 onto the 1kHz grid lands on every decimation-th sample.
+    if (stream->phase++ % stream->decimation != 0)
+        return false;
+
+    // movmean(kGravityWindow) is centered: x[i] - mean(x[i - 250 .. i + 249]) needs the 249 samples after i.
+    const int16_t values[kFeatureChannels] = {sample->ax, sample->ay, sample->az, sample->gx, sample->gy, sample->gz};
+    const uint32_t slot = stream->num_decimated % kGravityWindow;
+    for (int c = 0; c < kFeatureChannels; c++)
+    {
+        stream->history_sum[c] += values[c] - stream->history[c][slot];
+        stream->history[c][slot] = values[c];
+    }
+    stream->num_decimated++;
+    if (stream->num_decimated < kFeatureCrop + kGravityWindow / 2)
+        return false; // The shrinking ends of movmean are all inside the crop.
+
+    const uint32_t center = (stream->num_decimated - kGravityWindow / 2) % kGravityWindow;
+    const uint32_t clean_slot = stream->num_clean % kFeatureWindow;
+    for (int c = 0; c < kFeatureChannels; c++)
+        stream->window[c][clean_slot] = stream->history[c][center] * kGravityWindow - stream->history_sum[c];
+    stream->num_clean++;
+    stream->window_end_t = sample->t - (uint64_t)(kGravityWindow / 2 - 1) * 1000000 / kFeatureRateHz;
+    return stream->num_clean >= kFeatureWindow && (stream->num_clean - kFeatureWindow) % kFeatureHop == 0;
+}
+
+// Scaled mixed-radix Stockham FFT, self sorting. Returns which of the two buffers holds the result.
+static int Fft(int16_t re[2][kFeatureWindow], int16_t im[2][kFeatureWindow])
+{
+    int src = 0;
+    int n = kFeatureWindow, stride = 1;
+    for (int stage = 0; stage < kFftStages; stage++)
+    {
+        const int radix = kFftRadix[stage], m = n / radix, twiddle_step = kFeatureWindow / n;
+        const int16_t *xr = re[src], *xi = im[src];
+        int16_t *yr = re[!src], *yi = im[!src];
+        for (int q = 0; q < m; q++)
+        {
+            for (int k = 0; k < stride; k++)
+            {
+                int32_t br[5], bi[5];
+                if (radix == 2)
+                {
+                    const int a = k + stride * q, b = k + stride * (q + m);
+                    br[0] = (xr[a] + xr[b]) >> 1;
+                    bi[0] = (xi[a] + xi[b]) >> 1;
+                    br[1] = (xr[a] - xr[b]) >> 1;
+                    bi[1] = (xi[a] - xi[b]) >> 1;
+                }
+                else
+                {
+                    // Conjugate pairs (1, 4) and (2, 3) share their products. Inputs are summed in
+                    // int32, the coefficients are divided by 5 so the sums stay within one int16 input.
+                    int32_t ar[5], ai[5];
+                    for (int j = 0; j < 5; j++)
+                    {
+                        ar[j] = xr[k + stride * (q + m * j)];
+                        ai[j] = xi[k + stride * (q + m * j)];
+                    }
+                    const int32_t s1r = ar[1] + ar[4], s1i = ai[1] + ai[4], d1r = ar[1] - ar[4], d1i = ai[1] - ai[4];
+                    const int32_t s2r = ar[2] + ar[3], s2i = ai[2] + ai[3], d2r = ar[2] - ar[3], d2i = ai[2] - ai[3];
+                    br[0] = ((ar[0] + s1r + s2r) * kFifthQ15 + (1 << 14)) >> 15;
+                    bi[0] = ((ai[0] + s1i + s2i) * kFifthQ15 + (1 << 14)) >> 15;
+                    const int32_t t1r = ar[0] * kFifthQ15 + s1r * kCos1Q15 + s2r * kCos2Q15;
+                    const int32_t t1i = ai[0] * kFifthQ15 + s1i * kCos1Q15 + s2i * kCos2Q15;
+                    const int32_t t2r = ar[0] * kFifthQ15 + s1r * kCos2Q15 + s2r * kCos1Q15;
+                    const int32_t t2i = ai[0] * kFifthQ15 + s1i * kCos2Q15 + s2i * kCos1Q15;
+                    // -i times (sin1 d1 + sin2 d2) and (sin2 d1 - sin1 d2).
+                    const int32_t u1r = d1i * kSin1Q15 + d2i * kSin2Q15, u1i = -(d1r * kSin1Q15 + d2r * kSin2Q15);
+                    const int32_t u2r = d1i * kSin2Q15 - d2i * kSin1Q15, u2i = -(d1r * kSin2Q15 - d2r * kSin1Q15);
+                    br[1] = (t1r + u1r + (1 << 14)) >> 15;
+                    bi[1] = (t1i + u1i + (1 << 14)) >> 15;
+                    br[4] = (t1r - u1r + (1 << 14)) >> 15;
+                    bi[4] = (t1i - u1i + (1 << 14)) >> 15;
+                    br[2] = (t2r + u2r + (1 << 14)) >> 15;
+                    bi[2] = (t2i + u2i + (1 << 14)) >> 15;
+                    br[3] = (t2r - u2r + (1 << 14)) >> 15;
+                    bi[3] = (t2i - u2i + (1 << 14)) >> 15;
+                }
+
+                // Output r of butterfly q lands at q * radix + r, times exp(-2 pi i q r / n).
+                const int out = k + stride * q * radix;
+                yr[out] = (int16_t)br[0];
+                yi[out] = (int16_t)bi[0];
+                for (int r = 1; r < radix; r++)
+                {
+                    const int w = q * r * twiddle_step; // Below kFeatureWindow, q * r < n.
+                    yr[out + stride * r] = (int16_t)((br[r] * gTwiddleRe[w] - bi[r] * gTwiddleIm[w] + (1 << 14)) >> 15);
+                    yi[out + stride * r] = (int16_t)((br[r] * gTwiddleIm[w] + bi[r] * gTwiddleRe[w] + (1 << 14)) >> 15);
+                }
+            }
+        }
+        src = !src;
+        n = m;
+        stride *= radix;
+    }
+    return src;
+}
+
+static uint32_t Isqrt(uint32_t x)
+{
+    uint32_t root = 0, bit = 1u << 30;
+    while (bit > x)
+        bit >>= 2;
+    while (bit != 0)
+    {
+        if (x >= root + bit)
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+            root >>= 1;
+        bit >>= 2;
+    }
+    return root;
+}
+
+// log2(x) in Q16, x > 0. Table plus linear interpolation, within 2e-5.
+static int32_t Log2Q16(uint64_t x)
+{
+    const int exponent = 63 - __builtin_clzll(x);
+    const uint64_t normalized = x << (63 - exponent); // Leading one at bit 63.
+    const uint32_t index = (uint32_t)(normalized >> (63 - kLog2TableBits)) & ((1 << kLog2TableBits) - 1);
+    const uint32_t frac = (uint32_t)(normalized >> (63 - 2 * kLog2TableBits)) & ((1 << kLog2TableBits) - 1);
+    const uint32_t low = gLog2Table[index], high = gLog2Table[index + 1];
+    return exponent * kLog2One + (int32_t)(low + (((high - low) * frac) >> kLog2TableBits));
+}
+
+// Block floating point: x[i] * 2^exponent = samples[i], with x as large as fits under kSignalLimit.
+static int Normalize(const int32_t *samples, int16_t *x)
+{
+    int32_t peak = 0;
+    for (int i = 0; i < kFeatureWindow; i++)
+    {
+        const int32_t magnitude = samples[i] < 0 ? -samples[i] : samples[i];
+        peak = magnitude > peak ? magnitude : peak;
+    }
+    int exponent = 0;
+    while (peak > kSignalLimit)
+    {
+        peak >>= 1;
+        exponent++;
+    }
+    while (peak != 0 && peak <= kSignalLimit / 2)
+    {
+        peak <<= 1;
+        exponent--;
+    }
+    for (int i = 0; i < kFeatureWindow; i++)
+    {
+        if (exponent > 0)
+            x[i] = (int16_t)((samples[i] + (1 << (exponent - 1))) >> exponent);
+        else
+            x[i] = (int16_t)(samples[i] * (1 << -exponent));
+    }
+    return exponent;
+}
+
+// The eight features of one signal, scale converts x to signal units. The window is a rotation of the
+// time-ordered one, which changes none of the features: the statistics ignore order and a circular shift
+// only changes the phase of the spectrum.
+static void SignalFeatures(FeatureScratch *scratch, float scale, float *out)
+{
+    const int16_t *x = scratch->x;
+    int16_t(*re)[kFeatureWindow] = scratch->re, (*im)[kFeatureWindow] = scratch->im;
+    uint64_t *power = scratch->power;
+    int32_t sum = 0, min = x[0], max = x[0];
+    int64_t sum_sq = 0;
+    for (int i = 0; i < kFeatureWindow; i++)
+    {
+        sum += x[i];
+        sum_sq += x[i] * x[i];
+        min = x[i] < min ? x[i] : min;
+        max = x[i] > max ? x[i] : max;
+        re[0][i] = x[i];
+        im[0][i] = 0;
+    }
+    const int64_t var_num = (int64_t)kFeatureWindow * sum_sq - (int64_t)sum * sum;
+
+    // Single-sided power P1^2, in units of (scale / kFeatureWindow)^2 before the doubling.
+    const int result = Fft(re, im);
+    uint64_t power_sum = 0, max_power = 0;
+    int max_k = 0;
+    for (int k = 0; k < kSpectrumBins; k++)
+    {
+        const int32_t r = re[result][k], i = im[result][k];
+        power[k] = (uint32_t)(r * r) + (uint32_t)(i * i);
+        if (k > 0 && k < kSpectrumBins - 1)
+            power[k] *= 4;
+        if (power[k] > max_power)
+        {
+            max_power = power[k];
+            max_k = k;
+        }
+        power_sum += power[k];
+    }
+
+    // H = log2(S) - sum(p log2 p) / S over the nonzero bins, zero bins add nothing (eps log2 eps in MATLAB).
+    float entropy = 0;
+    if (power_sum > 0)
+    {
+        int64_t weighted = 0;
+        for (int k = 0; k < kSpectrumBins; k++)
+        {
+            if (power[k] != 0)
+                weighted += (int64_t)power[k] * Log2Q16(power[k]);
+        }
+        entropy = (Log2Q16(power_sum) - (float)weighted / (float)power_sum) / kLog2One;
+    }
+
+    const float scale_sq = scale * scale;
+    out[0] = sum * scale / kFeatureWindow;
+    out[1] = (float)var_num * scale_sq / ((float)kFeatureWindow * (kFeatureWindow - 1));
+    out[2] = sqrtf((float)sum_sq / kFeatureWindow) * scale;
+    out[3] = (max - min) * scale;
+    out[4] = (float)max_k * kFeatureRateHz / kFeatureWindow;
+    out[5] = (float)power_sum * scale_sq / kSpectrumBins;
+    out[6] = (float)max_power * scale_sq;
+    out[7] = entropy;
+}
+
+// |(x, y, z)| of three window rows, as samples for Normalize with their exponent.
+static int Magnitude(const int32_t *x, const int32_t *y, const int32_t *z, int32_t *magnitude)
+{
+    int32_t peak = 0;
+    for (int i = 0; i < kFeatureWindow; i++)
+    {
+        const int32_t values[3] = {x[i], y[i], z[i]};
+        for (int a = 0; a < 3; a++)
+        {
+            const int32_t v = values[a] < 0 ? -values[a] : values[a];
+            peak = v > peak ? v : peak;
+        }
+    }
+    int exponent = 0;
+    while (peak > 32767)
+    {
+        peak >>= 1;
+        exponent++;
+    }
+    for (int i = 0; i < kFeatureWindow; i++)
+    {
+        const int32_t xs = x[i] >> exponent, ys = y[i] >> exponent, zs = z[i] >> exponent;
+        magnitude[i] = (int32_t)Isqrt((uint32_t)(xs * xs) + (uint32_t)(ys * ys) + (uint32_t)(zs * zs));
+    }
+    return exponent;
+}
+
+void FeatureStreamExtract(FeatureStream *stream, float features[kNumFeatures])
+{
+    // Window values are counts times kGravityWindow.
+    const float unit = 1.0f / kGravityWindow;
+    FeatureScratch *scratch = &stream->scratch;
+    for (int sensor = 0; sensor < 2; sensor++)
+    {
+        const int32_t(*axes)[kFeatureWindow] = &stream->window[3 * sensor];
+        float *out = &features[4 * sensor * kFeaturesPerSignal];
+        for (int a = 0; a < 3; a++)
+        {
+            const int exponent = Normalize(axes[a], scratch->x);
+            SignalFeatures(scratch, ldexpf(unit, exponent), &out[a * kFeaturesPerSignal]);
+        }
+        const int magnitude_exponent = Magnitude(axes[0], axes[1], axes[2], scratch->magnitude);
+        const int exponent = Normalize(scratch->magnitude, scratch->x);
+        SignalFeatures(scratch, ldexpf(unit, magnitude_exponent + exponent), &out[3 * kFeaturesPerSignal]);
+    }
+}
+
+static int ArgMax(const float *scores, int n)
+{
+    int best = 0;
+    for (int i = 1; i < n; i++)
+    {
+        if (scores[i] > scores[best])
+            best = i;
+    }
+    return best;
+}
+
+int ClassifierPredict(const ClassifierModel *model, const float features[kNumFeatures], float *scores)
+{
+    float out[kMaxClasses] = {0};
+    if (model->kind == kModelTrees)
+    {
+        for (int t = 0; t < model->num_trees; t++)
+        {
+            const TreeNode *nodes = &model->nodes[model->tree_start[t]];
+            const TreeNode *node = nodes;
+            while (node->feature >= 0)
+                node = &nodes[features[node->feature] < node->threshold ? node->left : node->right];
+            const float *leaf = &model->leaf_scores[node->left * model->num_classes];
+            for (int c = 0; c < model->num_classes; c++)
+                out[c] += leaf[c];
+        }
+        for (int c = 0; c < model->num_classes; c++)
+            out[c] /= model->num_trees;
+    }
+    else
+    {
+        float a[kMaxLayerSize], z[kMaxLayerSize];
+        for (int i = 0; i < kNumFeatures; i++)
+            a[i] = (features[i] - model->mu[i]) * model->inv_sigma[i];
+        for (int l = 0; l < model->num_layers; l++)
+        {
+            const int in = model->layer_size[l], num_out = model->layer_size[l + 1];
+            const bool last = l == model->num_layers - 1;
+            for (int j = 0; j < num_out; j++)
+            {
+                const float *w = &model->weights[l][j * in];
+                float acc = model->biases[l][j];
+                for (int i = 0; i < in; i++)
+                    acc += w[i] * a[i];
+                z[j] = last || acc > 0 ? acc : 0;
+            }
+            memcpy(a, z, num_out * sizeof(float));
+        }
+
+        // Softmax, only the exps of the classes.
+        const int best = ArgMax(a, model->num_classes);
+        float total = 0;
+        for (int c = 0; c < model->num_classes; c++)
+        {
+            out[c] = expf(a[c] - a[best]);
+            total += out[c];
+        }
+        for (int c = 0; c < model->num_classes; c++)
+            out[c] /= total;
+    }
+
+    if (scores != NULL)
+        memcpy(scores, out, model->num_classes * sizeof(float));
+    return ArgMax(out, model->num_classes);
+}
+
+// x / 2^shift rounded and saturated to int16, shift may be negative.
+static int16_t RescaleQ(int32_t x, int shift)
+{
+    const int64_t y = shift > 0 ? ((int64_t)x + (1 << (shift - 1))) >> shift : (int64_t)x << -shift;
+    return y > 32767 ? 32767 : y < -32768 ? -32768 : (int16_t)y;
+}
+
+// Cuts not above x, by binary search. NaN ranks above all of them, like x < cut being false.
+static uint16_t CutRank(const float *cuts, uint32_t num_cuts, float x)
+{
+    uint32_t lo = 0, hi = num_cuts;
+    while (lo < hi)
+    {
+        const uint32_t mid = (lo + hi) / 2;
+        if (x < cuts[mid])
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return (uint16_t)lo;
+}
+
+int ClassifierPredictQ(const ClassifierModelQ *model, const float features[kNumFeatures], int32_t *scores)
+{
+    int32_t out[kMaxClasses] = {0};
+    int best = 0;
+    if (model->kind == kModelTrees)
+    {
+        uint16_t rank[kNumFeatures];
+        for (int i = 0; i < kNumFeatures; i++)
+        {
+            const uint32_t first = model->cut_start[i];
+            rank[i] = CutRank(&model->cuts[first], model->cut_start[i + 1] - first, features[i]);
+        }
+        // Q15 sums of up to 65535 trees fit in 32 bits.
+        for (int t = 0; t < model->num_trees; t++)
+        {
+            const TreeNodeQ *nodes = &model->nodes[model->tree_start[t]];
+            const TreeNodeQ *node = nodes;
+            while (node->feature >= 0)
+                node = &nodes[rank[node->feature] < node->threshold ? node->left : node->right];
+            const uint16_t *leaf = &model->leaf_scores[node->left * model->num_classes];
+            for (int c = 0; c < model->num_classes; c++)
+                out[c] += leaf[c];
+        }
+        for (int c = 0; c < model->num_classes; c++)
+        {
+            out[c] = (uint32_t)out[c] / model->num_trees;
+            if (out[c] > out[best])
+                best = c;
+        }
+    }
+    else
+    {
+        int16_t q[kMaxLayerSize], next[kMaxLayerSize];
+        for (int i = 0; i < kNumFeatures; i++)
+        {
+            const float v = floorf((features[i] - model->offset[i]) * model->scale[i]);
+            q[i] = v > 32767 ? 32767 : v < -32768 ? -32768 : (int16_t)v;
+        }
+        int input_q = kInputQ;
+        for (int l = 0; l < model->num_layers; l++)
+        {
+            const int in = model->layer_size[l], num_out = model->layer_size[l + 1];
+            const bool last = l == model->num_layers - 1;
+            // Accumulators are in Q(input_q + weight_shift), back to kHiddenQ for the next layer.
+            const int shift = input_q + model->weight_shift[l] - kHiddenQ;
+            for (int j = 0; j < num_out; j++)
+            {
+                const int16_t *w = &model->weights[l][j * in];
+                int32_t acc = model->biases[l][j];
+                for (int i = 0; i < in; i++)
+                    acc += w[i] * q[i];
+                if (last)
+                    out[j] = acc;
+                else
+                    next[j] = acc > 0 ? RescaleQ(acc, shift) : 0;
+            }
+            if (last)
+                break;
+            memcpy(q, next, num_out * sizeof(int16_t));
+            input_q = kHiddenQ;
+        }
+
+        // Softmax to Q15 in float, one exp per class and window.
+        const float unit = ldexpf(1.0f, -(input_q + model->weight_shift[model->num_layers - 1]));
+        for (int c = 1; c < model->num_classes; c++)
+        {
+            if (out[c] > out[best])
+                best = c;
+        }
+        float p[kMaxClasses], total = 0;
+        for (int c = 0; c < model->num_classes; c++)
+        {
+            p[c] = expf(((float)out[c] - (float)out[best]) * unit);
+            total += p[c];
+        }
+        for (int c = 0; c < model->num_classes; c++)
+            out[c] = (int32_t)lrintf(p[c] / total * 32767);
+    }
+
+    if (scores != NULL)
+        memcpy(scores, out, model->num_classes * sizeof(int32_t));
+    return best;
+}
+
+bool BatchClassifierInit(BatchClassifier *classifier, uint32_t odr_hz, const ClassifierModel *model,
+                         const ClassifierModelQ *model_q, bool keep_samples)
+{
+    memset(classifier, 0, sizeof(*classifier));
+    classifier->odr_hz = odr_hz;
+    classifier->model = model;
+    classifier->model_q = model_q;
+    classifier->keep_samples = keep_samples;
+    return FeatureStreamInit(&classifier->stream, odr_hz);
+}
+
+size_t BatchClassifierPopLimit(const BatchClassifier *classifier, size_t space)
+{
+    if (!classifier->keep_samples)
+        return space; // Labels overwrite samples already read.
+    // n samples complete at most n / samples_per_label + 1 windows.
+    const size_t samples_per_label = (size_t)kFeatureHop * classifier->stream.decimation;
+    const size_t reserve = space / samples_per_label + 1;
+    return space > reserve ? space - reserve : 0;
+}
+
+size_t BatchClassifierRun(BatchClassifier *classifier, void *batch, size_t count)
+{
+    uint8_t *records = batch;
+    size_t num_out = classifier->keep_samples ? count : 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        ImuSample sample;
+        memcpy(&sample, &records[i * sizeof(ImuSample)], sizeof(ImuSample));
+        // The stats trailer and other non-sample records go through unclassified.
+        if (sample.t & kLabelRecordFlag)
+        {
+            if (!classifier->keep_samples)
+                memcpy(&records[num_out++ * sizeof(ImuSample)], &sample, sizeof(ImuSample));
+            continue;
+        }
+        if (sample.t < classifier->prev_t)
+            FeatureStreamInit(&classifier->stream, classifier->odr_hz);
+        classifier->prev_t = sample.t;
+        if (!FeatureStreamPush(&classifier->stream, &sample))
+            continue;
+
+        float *features = classifier->features;
+        FeatureStreamExtract(&classifier->stream, features);
+        int label;
+        float score;
+        if (classifier->model != NULL)
+        {
+            float scores[kMaxClasses];
+            label = ClassifierPredict(classifier->model, features, scores);
+            score = scores[label] * 32767;
+        }
+        else
+        {
+            int32_t scores[kMaxClasses];
+            label = ClassifierPredictQ(classifier->model_q, features, scores);
+            score = (float)scores[label];
+        }
+        const ImuSample record = {.t = classifier->stream.window_end_t | kLabelRecordFlag,
+                                  .ax = (int16_t)label,
+                                  .ay = (int16_t)(score < 32767 ? score : 32767)};
+        memcpy(&records[num_out * sizeof(ImuSample)], &record, sizeof(ImuSample));
+        num_out++;
+        classifier->windows++;
+    }
+    return num_out;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "imu_core.h"
+
+// Surface classifier for core 1: a streaming version of processData.m's 64 window features and the
+// bagged trees / neural net models written by exportModelWeights.m, evaluated in float32 or fixed point.
+// No SDK calls, host/classifier_bench runs the same code against the double MATLAB pipeline.
+
+enum
+{
+    // processData.m parameters.
+    kFeatureRateHz = 1000, // targetFs. The IMU ODR must be a multiple, samples are picked like interp1 does.
+    kFeatureWindow = 200,  // blocksize, 200 ms.
+    kFeatureHop = 50,      // hop, 50 ms.
+    kGravityWindow = 500,  // movmean window subtracted as gravity, 0.5 s.
+    kFeatureCrop = 500,    // Filter startup transient dropped, 0.5 s.
+    kFeatureChannels = 6,  // ax ay az gx gy gz.
+    kFeatureSignals = 8,   // ax ay az |a| gx gy gz |g|.
+    kFeaturesPerSignal = 8,
+    kNumFeatures = kFeatureSignals * kFeaturesPerSignal,
+    kSpectrumBins = kFeatureWindow / 2 + 1,
+
+    kMaxClasses = 8,
+    kMaxLayers = 4,      // Weight layers, hidden plus output.
+    kMaxLayerSize = 128, // Widest layer, WideNN is 100.
+    kInputQ = 12,        // Fixed-point net inputs are z-scores in Q12.
+    kHiddenQ = 10,       // Fixed-point hidden activations, room for +-32.
+};
+
+// Label records share the 24 byte sample framing so a reader can tell them apart by t alone:
+// t is the window end time with this bit set, ax the class index and ay the score in Q15.
+static const uint64_t kLabelRecordFlag = 1ull << 63;
+
+// Working buffers of FeatureStreamExtract(), kept off the stack: core 1 only has the SDK's 2 KB.
+typedef struct
+{
+    int16_t x[kFeatureWindow]; // One signal, normalized to int16.
+    int32_t magnitude[kFeatureWindow];
+    int16_t re[2][kFeatureWindow]; // FFT ping-pong buffers.
+    int16_t im[2][kFeatureWindow];
+    uint64_t power[kSpectrumBins];
+} FeatureScratch;
+
+// Gravity removal and windowing, one decimated sample at a time. Everything up to the final
+// per-feature scaling is integer, the RP2040 has no FPU.
+typedef struct
+{
+    uint32_t decimation; // ODR / kFeatureRateHz.
+    uint32_t phase;
+    int16_t history[kFeatureChannels][kGravityWindow]; // Last kGravityWindow decimated samples, ring.
+    int32_t history_sum[kFeatureChannels];
+    uint32_t num_decimated;
+    // Gravity-free samples times kGravityWindow, exact in integers. Ring of the last kFeatureWindow.
+    int32_t window[kFeatureChannels][kFeatureWindow];
+    uint32_t num_clean;
+    uint64_t window_end_t; // Microseconds, time of the newest sample in the window.
+    FeatureScratch scratch;
+} FeatureStream;
+
+// Returns false if odr_hz is not a multiple of kFeatureRateHz.
+bool FeatureStreamInit(FeatureStream *stream, uint32_t odr_hz);
+// Returns true when a new window is complete, every kFeatureHop ms after the first
+// kFeatureCrop + kGravityWindow / 2 + kFeatureWindow ms.
+bool FeatureStreamPush(FeatureStream *stream, const ImuSample *sample);
+// Features of the newest window, in processData.m's column order (Ax_mean, Ax_var, ...).
+void FeatureStreamExtract(FeatureStream *stream, float features[kNumFeatures]);
+
+typedef enum
+{
+    kModelTrees = 1, // Bagged classification trees, scores are averaged leaf class probabilities.
+    kModelNet = 2,   // fitcnet: standardized inputs, ReLU hidden layers, softmax output.
+} ModelKind;
+
+// Children index nodes of the same tree. Leaves have feature -1 and left is their row in leaf_scores.
+typedef struct
+{
+    int16_t feature;
+    uint16_t left;
+    uint16_t right;
+    float threshold; // Go left when x < threshold, like MATLAB.
+} TreeNode;
+
+typedef struct
+{
+    int16_t feature;
+    uint16_t left;
+    uint16_t right;
+    uint16_t threshold; // Go left when the feature's cut rank is below this, the cut's index plus one.
+} TreeNodeQ;
+
+typedef struct
+{
+    ModelKind kind;
+    uint16_t num_classes;
+
+    uint16_t num_trees;
+    const uint32_t *tree_start; // First node of each tree.
+    const TreeNode *nodes;
+    const float *leaf_scores; // [num_leaves][num_classes] class probabilities.
+
+    const float *mu;        // Net inputs are (x - mu) * inv_sigma.
+    const float *inv_sigma;
+    uint16_t num_layers;
+    uint16_t layer_size[kMaxLayers + 1]; // Input first.
+    const float *weights[kMaxLayers];    // [out][in].
+    const float *biases[kMaxLayers];
+} ClassifierModel;
+
+// Fixed point. Trees see each feature as its rank among that feature's sorted distinct split cuts
+// (how many are <= x), found once per window, so x < cut is an exact integer compare whatever range
+// the feature covers. Nets see Q12 z-scores q = (x - offset) * scale saturated to int16, weights are
+// int16 in Q(weight_shift) chosen so the int32 accumulators can't overflow, biases are in the
+// accumulator's Q.
+typedef struct
+{
+    ModelKind kind;
+    uint16_t num_classes;
+    const float *offset;
+    const float *scale;
+
+    uint16_t num_trees;
+    const uint32_t *tree_start;
+    const TreeNodeQ *nodes;
+    const uint16_t *leaf_scores; // Q15 class probabilities.
+    const uint32_t *cut_start;   // [kNumFeatures + 1], cuts of feature f are cut_start[f] to cut_start[f + 1].
+    const float *cuts;           // Ascending within each feature.
+
+    uint16_t num_layers;
+    uint16_t layer_size[kMaxLayers + 1];
+    const int16_t *weights[kMaxLayers];
+    const int32_t *biases[kMaxLayers];
+    uint8_t weight_shift[kMaxLayers];
+} ClassifierModelQ;
+
+// Returns the class index. scores (may be NULL) gets num_classes class probabilities.
+int ClassifierPredict(const ClassifierModel *model, const float features[kNumFeatures], float *scores);
+// Returns the class index. scores (may be NULL) gets num_classes class probabilities in Q15.
+int ClassifierPredictQ(const ClassifierModelQ *model, const float features[kNumFeatures], int32_t *scores);
+
+// Core 1 side: classifies the batches popped from the sample ring in place, before they go to USB.
+typedef struct
+{
+    FeatureStream stream;
+    uint32_t odr_hz;
+    const ClassifierModel *model;    // float32 model, or
+    const ClassifierModelQ *model_q; // the fixed-point one, the other NULL.
+    bool keep_samples;               // Raw samples plus labels, otherwise labels only.
+    uint64_t prev_t;                 // A smaller t starts a new recording and a new stream.
+    uint32_t windows;                // Labels produced, for a debugger.
+    float features[kNumFeatures];    // Newest window's features, off the core 1 stack.
+} BatchClassifier;
+
+// Returns false if odr_hz is not a multiple of kFeatureRateHz.
+bool BatchClassifierInit(BatchClassifier *classifier, uint32_t odr_hz, const ClassifierModel *model,
+                         const ClassifierModelQ *model_q, bool keep_samples);
+// Samples to pop into a buffer of space records so the labels they complete still fit.
+size_t BatchClassifierPopLimit(const BatchClassifier *classifier, size_t space);
+// Runs count samples of batch (any alignment) through the model. Returns the records now in batch: the
+// label records alone, or the samples followed by the labels of the windows they completed.
+size_t BatchClassifierRun(BatchClassifier *classifier, void *batch, size_t count);
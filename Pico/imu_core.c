@@ -0,0 +1,175 @@
+#include "imu_core.h"
+
+#include <string.h>
+
+void SampleRingInit(SampleRing *ring, ImuSample *slots, uint32_t size)
+{
+    ring->slots = slots;
+    ring->size = size;
+    SampleRingClear(ring);
+}
+
+void SampleRingClear(SampleRing *ring)
+{
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+    ring->tail_cache = 0;
+    ring->head_cache = 0;
+}
+
+bool SampleRingPush(SampleRing *ring, const ImuSample *sample)
+{
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const uint32_t next = head + 1 == ring->size ? 0 : head + 1;
+    if (next == ring->tail_cache)
+    {
+        ring->tail_cache = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (next == ring->tail_cache)
+            return false;
+    }
+    ring->slots[head] = *sample;
+    atomic_store_explicit(&ring->head, next, memory_order_release);
+    return true;
+}
+
+uint32_t SampleRingLevel(SampleRing *ring)
+{
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    return head >= tail ? head - tail : head + ring->size - tail;
+}
+
+size_t SampleRingPopBatch(SampleRing *ring, void *dst, size_t max_samples)
+{
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail == ring->head_cache)
+    {
+        ring->head_cache = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail == ring->head_cache)
+            return 0;
+    }
+    const uint32_t head = ring->head_cache;
+
+    // At most two copies, up to the end of the slots and then from the start.
+    size_t available = head >= tail ? head - tail : head + ring->size - tail;
+    size_t count = available < max_samples ? available : max_samples;
+    size_t first = ring->size - tail < count ? ring->size - tail : count;
+    memcpy(dst, &ring->slots[tail], first * sizeof(ImuSample));
+    memcpy((uint8_t *)dst + first * sizeof(ImuSample), ring->slots, (count - first) * sizeof(ImuSample));
+
+    uint32_t next = tail + count;
+    if (next >= ring->size)
+        next -= ring->size;
+    atomic_store_explicit(&ring->tail, next, memory_order_release);
+    return count;
+}
+
+void ImuIngestStart(ImuIngest *ingest, SampleRing *ring, uint32_t odr_hz, ImuOverflowPolicy policy)
+{
+    *ingest = (ImuIngest){0};
+    ingest->ring = ring;
+    ingest->policy = policy;
+    ingest->period_ticks = kClkinHz / odr_hz;
+}
+
+int ImuIngestBurstPackets(const ImuIngest *ingest)
+{
+    return ingest->backlog < kFifoMaxBurstPackets ? 1 + ingest->backlog : kFifoMaxBurstPackets;
+}
+
+// One FIFO packet. Drops glitched packets and repeats before they reach the ring.
+static ImuIngestResult IngestPacket(ImuIngest *ingest, const uint8_t *packet)
+{
+    ImuReadStats *stats = &ingest->stats;
+    if ((packet[0] & kFifoHeaderMask) != kFifoHeaderExpected)
+    {
+        stats->invalid++;
+        return kIngestFlush;
+    }
+
+    // Parse IMU bits.
+    ImuSample data = {0,
+                      (packet[1] << 8) + packet[2], (packet[3] << 8) + packet[4], (packet[5] << 8) + packet[6],
+                      (packet[7] << 8) + packet[8], (packet[9] << 8) + packet[10], (packet[11] << 8) + packet[12]};
+    const uint16_t tmst = (packet[14] << 8) + packet[15];
+    if (data.ax == kFifoInvalidSample || data.gx == kFifoInvalidSample)
+    {
+        stats->invalid++;
+        return kIngestSkipped;
+    }
+    if (ingest->have_prev_sample && tmst == ingest->prev_tmst)
+    {
+        stats->duplicates++;
+        return kIngestSkipped;
+    }
+    if (ingest->have_prev_sample)
+    {
+        const uint16_t delta = tmst - ingest->prev_tmst;
+        if (delta > ingest->period_ticks + ingest->period_ticks / 2)
+            stats->gaps++;
+        ingest->sensor_ticks += delta;
+    }
+    data.t = ingest->sensor_ticks * 1000000 / kClkinHz; // Rounded down, exact up to 1kHz ODR.
+    ingest->prev_tmst = tmst;
+    ingest->have_prev_sample = true;
+
+    if (SampleRingPush(ingest->ring, &data) == false)
+    {
+        if (ingest->policy == kOverflowStop)
+            return kIngestOverflow;
+        stats->dropped++;
+        return kIngestSkipped;
+    }
+    stats->samples++;
+    return kIngestQueued;
+}
+
+ImuIngestResult ImuIngestBurst(ImuIngest *ingest, const uint8_t *burst, int num_packets)
+{
+    ImuReadStats *stats = &ingest->stats;
+    if (burst[1] & kIntStatusFifoFull)
+        stats->overflows++;
+
+    // The FIFO count is from before this pop, packets past it are empty markers.
+    const int fifo_count = (burst[2] << 8) | burst[3];
+    if (fifo_count == 0)
+    {
+        stats->empty++;
+        ingest->backlog = 0;
+        return kIngestSkipped;
+    }
+    if (num_packets > fifo_count)
+        num_packets = fifo_count;
+    ingest->backlog = fifo_count - num_packets;
+
+    ImuIngestResult result = kIngestSkipped;
+    for (int i = 0; i < num_packets; i++)
+    {
+        const ImuIngestResult packet_result = IngestPacket(ingest, &burst[kFifoBurstOverhead + i * kFifoPacketSize]);
+        if (packet_result == kIngestFlush || packet_result == kIngestOverflow)
+        {
+            ingest->backlog = 0; // The caller flushes or stops, either way the FIFO starts over.
+            return packet_result;
+        }
+        if (packet_result == kIngestQueued)
+            result = kIngestQueued;
+    }
+    return result;
+}
+
+void ImuStatsRecords(const ImuReadStats *stats, ImuSample records[kNumStatsRecords])
+{
+    uint32_t counters[kNumStatsRecords];
+    memcpy(counters, stats, sizeof(counters));
+    for (int i = 0; i < kNumStatsRecords; i++)
+    {
+        records[i] = (ImuSample){.t = kStatsRecordFlag | i,
+                                 .ax = (int16_t)(counters[i] & 0xFFFF),
+                                 .ay = (int16_t)(counters[i] >> 16)};
+    }
+}
+
+size_t ImuFrameBatch(SampleRing *ring, void *dst, size_t space)
+{
+    return SampleRingPopBatch(ring, dst, space / sizeof(ImuSample)) * sizeof(ImuSample);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Hardware-independent part of the firmware: FIFO burst parsing, the core 0 -> core 1 sample ring
+// and batch framing for the transport. No SDK calls, so it also builds on the host (see host/).
+
+enum
+{
+    // FIFO packet 3: header, accel xyz, gyro xyz, temperature, 16 bit timestamp.
+    kFifoPacketSize = 16,
+    // Read burst starts at INT_STATUS and runs through FIFO_COUNTH/L into FIFO_DATA.
+    kFifoBurstOverhead = 4,
+    kFifoBurstSize = kFifoBurstOverhead + kFifoPacketSize,
+    // Most packets popped in one burst, a backlog left by a missed edge is drained this many at a time.
+    kFifoMaxBurstPackets = 8,
+    kFifoMaxBurstSize = kFifoBurstOverhead + kFifoPacketSize * kFifoMaxBurstPackets,
+    kFifoHeaderMask = 0xFC,
+    kFifoHeaderExpected = 0x68, // Accel, gyro and ODR timestamp present.
+    kFifoInvalidSample = -32768,
+    kIntStatusFifoFull = 0x02,
+
+    // CLKIN reference. The IMU derives its ODR and timestamp from this in RTC mode.
+    kClkinHz = 32000,
+};
+
+// One sample as sent to the host.
+typedef struct
+{
+    uint64_t t; // Microseconds since recording start, from the IMU timestamp.
+    int16_t ax;
+    int16_t ay;
+    int16_t az;
+    int16_t gx;
+    int16_t gy;
+    int16_t gz;
+} ImuSample;
+
+// Validity counters for the current recording, sent to the host as the stats trailer when it ends.
+typedef struct
+{
+    uint32_t samples;    // Valid samples queued.
+    uint32_t empty;      // Edges that found no new data (spurious or stale).
+    uint32_t duplicates; // Samples with the same timestamp as the previous one.
+    uint32_t invalid;    // Bad FIFO header or invalid-data marker, FIFO is flushed.
+    uint32_t gaps;       // Timestamp jumps larger than 1.5 sample periods.
+    uint32_t overflows;  // Reads that saw the FIFO full flag.
+    uint32_t dropped;    // Valid samples lost to a full ring with kOverflowDrop.
+} ImuReadStats;
+
+// Records with bit 63 of t set are not samples. Label records (imu_classifier.h) leave bit 62 clear,
+// the stats trailer sets both: one record per ImuReadStats counter in field order, t is the flag
+// plus the counter index and the value is split over ax (low half) and ay (high half).
+static const uint64_t kStatsRecordFlag = 3ull << 62;
+enum
+{
+    kNumStatsRecords = sizeof(ImuReadStats) / sizeof(uint32_t),
+};
+
+// The stats trailer that closes a recording, after its last sample.
+void ImuStatsRecords(const ImuReadStats *stats, ImuSample records[kNumStatsRecords]);
+
+// Single producer (core 0), single consumer (core 1) ring. No locks, each index has one writer.
+typedef struct
+{
+    ImuSample *slots;
+    uint32_t size;         // Slots allocated, one stays free to tell full from empty.
+    _Atomic uint32_t head; // Next slot to write, written by the producer.
+    _Atomic uint32_t tail; // Next slot to read, written by the consumer.
+    uint32_t tail_cache;   // Producer's last view of tail, saves cross-core reads.
+    uint32_t head_cache;   // Consumer's last view of head.
+} SampleRing;
+
+void SampleRingInit(SampleRing *ring, ImuSample *slots, uint32_t size);
+void SampleRingClear(SampleRing *ring); // Only while both sides are idle.
+bool SampleRingPush(SampleRing *ring, const ImuSample *sample);
+uint32_t SampleRingLevel(SampleRing *ring);
+// Copy up to max_samples oldest samples to dst (any alignment) and free their slots.
+size_t SampleRingPopBatch(SampleRing *ring, void *dst, size_t max_samples);
+
+// What to do when the ring is full.
+typedef enum
+{
+    kOverflowStop, // End the recording, the host sees a clean cut.
+    kOverflowDrop, // Keep recording and count the lost samples.
+} ImuOverflowPolicy;
+
+typedef enum
+{
+    kIngestQueued,   // Sample pushed to the ring.
+    kIngestSkipped,  // Nothing to queue (empty read, invalid marker, duplicate, dropped).
+    kIngestFlush,    // Packet glitched, caller must flush the IMU FIFO.
+    kIngestOverflow, // Ring full with kOverflowStop, caller must end the recording.
+} ImuIngestResult;
+
+// Turns FIFO bursts into timestamped samples on the ring.
+typedef struct
+{
+    SampleRing *ring;
+    ImuOverflowPolicy policy;
+    uint16_t period_ticks; // Sample period in CLKIN ticks.
+    uint16_t prev_tmst;
+    bool have_prev_sample;
+    uint64_t sensor_ticks; // IMU timestamp extended past its 16 bit wrap.
+    uint16_t backlog;      // Packets the last burst left in the FIFO, from its FIFO count.
+    ImuReadStats stats;
+} ImuIngest;
+
+// Call at the start of every recording, after flushing the IMU FIFO.
+void ImuIngestStart(ImuIngest *ingest, SampleRing *ring, uint32_t odr_hz, ImuOverflowPolicy policy);
+// Packets to pop in the next burst: one plus the backlog, at most kFifoMaxBurstPackets.
+int ImuIngestBurstPackets(const ImuIngest *ingest);
+// burst holds kFifoBurstOverhead + num_packets * kFifoPacketSize bytes read from INT_STATUS onwards.
+// Returns kIngestQueued if any sample was queued, otherwise the reason none was.
+ImuIngestResult ImuIngestBurst(ImuIngest *ingest, const uint8_t *burst, int num_packets);
+
+// Pop as many whole samples as fit in space bytes of dst. Returns bytes written.
+size_t ImuFrameBatch(SampleRing *ring, void *dst, size_t space);
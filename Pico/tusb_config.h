@@ -0,0 +1,22 @@
+#pragma once
+
+// TinyUSB configuration for IMU_USB_VENDOR builds: CDC for control/debug, vendor bulk for samples.
+
+#define CFG_TUD_ENABLED 1
+#define CFG_TUSB_RHPORT0_MODE OPT_MODE_DEVICE
+#define CFG_TUD_ENDPOINT0_SIZE 64
+
+#define CFG_TUD_CDC 1
+#define CFG_TUD_VENDOR 1
+#define CFG_TUD_MSC 0
+#define CFG_TUD_HID 0
+#define CFG_TUD_MIDI 0
+
+#define CFG_TUD_CDC_RX_BUFSIZE 64
+#define CFG_TUD_CDC_TX_BUFSIZE 256
+#define CFG_TUD_CDC_EP_BUFSIZE 64
+
+// Large TX FIFO so a whole staging buffer can be queued between tud_task() calls.
+#define CFG_TUD_VENDOR_RX_BUFSIZE 64
+#define CFG_TUD_VENDOR_TX_BUFSIZE 4096
+#define CFG_TUD_VENDOR_EPSIZE 64
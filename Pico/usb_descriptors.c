@@ -0,0 +1,100 @@
+#include <string.h>
+#include <tusb.h>
+
+// Composite device: CDC (control and debug text) plus one vendor interface with bulk IN/OUT.
+
+#ifndef IMU_USB_VID
+#define IMU_USB_VID 0xCAFE
+#endif
+#ifndef IMU_USB_PID
+#define IMU_USB_PID 0x4010
+#endif
+
+enum
+{
+    kItfNumCdc = 0,
+    kItfNumCdcData,
+    kItfNumVendor,
+    kItfNumTotal,
+};
+
+enum
+{
+    kEpCdcNotif = 0x81,
+    kEpCdcOut = 0x02,
+    kEpCdcIn = 0x82,
+    kEpVendorOut = 0x03,
+    kEpVendorIn = 0x83,
+};
+
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_VENDOR_DESC_LEN)
+
+static const tusb_desc_device_t kDescDevice = {
+    .bLength = sizeof(tusb_desc_device_t),
+    .bDescriptorType = TUSB_DESC_DEVICE,
+    .bcdUSB = 0x0200,
+    // IAD is required for the CDC interface pair in a composite device.
+    .bDeviceClass = TUSB_CLASS_MISC,
+    .bDeviceSubClass = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol = MISC_PROTOCOL_IAD,
+    .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor = IMU_USB_VID,
+    .idProduct = IMU_USB_PID,
+    .bcdDevice = 0x0100,
+    .iManufacturer = 1,
+    .iProduct = 2,
+    .iSerialNumber = 3,
+    .bNumConfigurations = 1,
+};
+
+static const uint8_t kDescConfiguration[] = {
+    TUD_CONFIG_DESCRIPTOR(1, kItfNumTotal, 0, CONFIG_TOTAL_LEN, 0x00, 100),
+    TUD_CDC_DESCRIPTOR(kItfNumCdc, 4, kEpCdcNotif, 8, kEpCdcOut, kEpCdcIn, 64),
+    TUD_VENDOR_DESCRIPTOR(kItfNumVendor, 5, kEpVendorOut, kEpVendorIn, 64),
+};
+
+static const char *const kDescStrings[] = {
+    NULL, // 0 is the language id.
+    "Imu-Robot-Finger",
+    "IMU sample streamer",
+    "0001",
+    "IMU control",
+    "IMU samples",
+};
+
+uint8_t const *tud_descriptor_device_cb(void)
+{
+    return (uint8_t const *)&kDescDevice;
+}
+
+uint8_t const *tud_descriptor_configuration_cb(uint8_t index)
+{
+    (void)index;
+    return kDescConfiguration;
+}
+
+// Strings are converted to UTF-16 on request.
+uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid)
+{
+    (void)langid;
+    static uint16_t desc_str[32];
+    size_t len;
+    if (index == 0)
+    {
+        desc_str[1] = 0x0409; // English.
+        len = 1;
+    }
+    else
+    {
+        if (index >= sizeof(kDescStrings) / sizeof(kDescStrings[0]))
+            return NULL;
+        const char *str = kDescStrings[index];
+        len = strlen(str);
+        if (len > 31)
+            len = 31;
+        for (size_t i = 0; i < len; i++)
+            desc_str[1 + i] = str[i];
+    }
+    desc_str[0] = (uint16_t)((TUSB_DESC_STRING << 8) | (2 * len + 2));
+    return desc_str;
+}
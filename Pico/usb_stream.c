@@ -0,0 +1,82 @@
+#include "usb_stream.h"
+
+#include <pico/stdlib.h>
+#include <string.h>
+#include <tusb.h>
+
+enum
+{
+    kStreamBufferSize = 4096,
+    // Staged data older than this is sent even if the buffer isn't full, bounds latency.
+    kStreamFlushUs = 2000,
+};
+
+static uint8_t gStreamBuffers[2][kStreamBufferSize] __attribute__((aligned(8))); // Callers store structs here.
+static size_t gFillLen = 0;             // Bytes in the buffer being filled.
+static int gFillIndex = 0;              // Buffer being filled, the other one is draining.
+static size_t gSendLen = 0, gSendPos = 0; // Draining buffer length and bytes already sent.
+static uint64_t gFillStartUs = 0;       // When the first byte entered the fill buffer.
+
+void UsbStreamInit(void)
+{
+    tusb_init();
+}
+
+bool UsbStreamConnected(void)
+{
+    return tud_mounted();
+}
+
+uint8_t *UsbStreamFillBuffer(size_t *space)
+{
+    *space = kStreamBufferSize - gFillLen;
+    return &gStreamBuffers[gFillIndex][gFillLen];
+}
+
+void UsbStreamCommit(size_t len)
+{
+    if (gFillLen == 0 && len > 0)
+        gFillStartUs = time_us_64();
+    gFillLen += len;
+}
+
+void UsbStreamTask(void)
+{
+    tud_task();
+
+    // Hand the fill buffer over once the previous one is fully queued on the endpoint,
+    // and the fill buffer has less than a bulk packet of room left or has waited long enough.
+    if (gSendPos == gSendLen && gFillLen > 0 &&
+        (kStreamBufferSize - gFillLen < CFG_TUD_VENDOR_EPSIZE || time_us_64() - gFillStartUs > kStreamFlushUs))
+    {
+        gSendLen = gFillLen;
+        gSendPos = 0;
+        gFillIndex ^= 1;
+        gFillLen = 0;
+    }
+
+    // Queue as much of the draining buffer as the endpoint FIFO takes.
+    if (gSendPos < gSendLen && tud_vendor_mounted())
+    {
+        gSendPos += tud_vendor_write(&gStreamBuffers[gFillIndex ^ 1][gSendPos], gSendLen - gSendPos);
+        tud_vendor_write_flush();
+    }
+}
+
+int UsbStreamGetCommand(void)
+{
+    uint8_t command;
+    if (tud_vendor_available() && tud_vendor_read(&command, 1) == 1)
+        return command;
+    if (tud_cdc_available() && tud_cdc_read(&command, 1) == 1)
+        return command;
+    return -1;
+}
+
+void UsbCdcPuts(const char *str)
+{
+    if (tud_cdc_connected() == false)
+        return;
+    tud_cdc_write(str, strlen(str));
+    tud_cdc_write_flush();
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Vendor-class bulk IN streaming (IMU_USB_VENDOR builds), CDC stays for control and debug text.
+// Two staging buffers: one is filled from the sample queue while the other drains to the endpoint.
+// Everything here must run on the core that called UsbStreamInit().
+
+void UsbStreamInit(void);
+// Service TinyUSB and move staged data to the endpoint. Call as often as possible.
+void UsbStreamTask(void);
+bool UsbStreamConnected(void);
+// Free space at the end of the buffer being filled, append with UsbStreamCommit().
+uint8_t *UsbStreamFillBuffer(size_t *space);
+void UsbStreamCommit(size_t len);
+// Next command byte from the vendor OUT endpoint or CDC, -1 if none.
+int UsbStreamGetCommand(void);
+// Text on the CDC interface, dropped if no terminal is open. Used for the end of recording stats.
+void UsbCdcPuts(const char *str);
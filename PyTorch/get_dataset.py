@@ -13,10 +13,10 @@ def GetDataset():
 
     # Load the CSV files
     table_dataframes = list(
-        map(lambda file_path: pd.read_csv(file_path), table_csv_paths)
+        map(lambda file_path: pd.read_csv(file_path, comment="#"), table_csv_paths)
     )
     wall_dataframes = list(
-        map(lambda file_path: pd.read_csv(file_path), wall_csv_paths)
+        map(lambda file_path: pd.read_csv(file_path, comment="#"), wall_csv_paths)
     )
     all_dataframes = table_dataframes + wall_dataframes
 
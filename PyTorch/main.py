@@ -19,7 +19,7 @@ def sdp_demo():
         r"C:\Users\hylth\Documents\Pico\ImuRobotFinger\PyTorch\csv/*.csv"
     )
 
-    dataframes = [pd.read_csv(file) for file in glob_foo]
+    dataframes = [pd.read_csv(file, comment="#") for file in glob_foo]
 
     data_amag_numpy = [
         dist(
@@ -65,7 +65,7 @@ def plot_csv_raw():
         r"C:\Users\hylth\Documents\Pico\ImuRobotFinger\PyTorch\csv/*.csv"
     )
 
-    dataframes = [pd.read_csv(file) for file in glob_foo]
+    dataframes = [pd.read_csv(file, comment="#") for file in glob_foo]
 
     data_amag_numpy = [
         dist(
@@ -89,7 +89,7 @@ def plot_csv_feature_extraction():
         r"C:\Users\hylth\Documents\Pico\ImuRobotFinger\PyTorch\csv/*.csv"
     )
 
-    dataframes = [pd.read_csv(file) for file in glob_foo]
+    dataframes = [pd.read_csv(file, comment="#") for file in glob_foo]
 
     data_amag_numpy = [
         dist(
@@ -145,7 +145,7 @@ def plot_csv_autocorrelation():
         r"C:\Users\hylth\Documents\Pico\ImuRobotFinger\PyTorch\csv/*.csv"
     )
 
-    dataframes = [pd.read_csv(file) for file in glob_foo]
+    dataframes = [pd.read_csv(file, comment="#") for file in glob_foo]
 
     data_amag_numpy = [
         dist(
@@ -173,7 +173,7 @@ def plot_csv_detrended_position():
         r"C:\Users\hylth\Documents\Pico\ImuRobotFinger\PyTorch\csv/*.csv"
     )
 
-    dataframes = [pd.read_csv(file) for file in glob_foo]
+    dataframes = [pd.read_csv(file, comment="#") for file in glob_foo]
 
     data_amag_numpy = [
         dist(
@@ -199,7 +199,7 @@ def play_csv():
         r"C:\Users\hylth\Documents\Pico\ImuRobotFinger\PyTorch\csv\*.csv"
     )
 
-    dataframes = [pd.read_csv(file) for file in glob_foo]
+    dataframes = [pd.read_csv(file, comment="#") for file in glob_foo]
 
     for idx, df in enumerate(dataframes):
         sample_rate = int(1 / df.iloc[:, 0].diff().median())
@@ -291,7 +291,7 @@ def foo():
         r"C:\Users\hylth\Documents\Pico\ImuRobotFinger\PyTorch\csv\AirVersusTable/*"
     )
 
-    dataframes = [pd.read_csv(file) for file in glob_foo]
+    dataframes = [pd.read_csv(file, comment="#") for file in glob_foo]
 
     for df, plt_idx in zip(dataframes, range(1, 100)):
         plt.subplot(3, 1, plt_idx)
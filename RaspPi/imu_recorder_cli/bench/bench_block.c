@@ -0,0 +1,253 @@
+// Parse and consumer cost of sample blocks (imu_block.h) against the per-sample ImuSample_t path
+// they replaced. Every block result is checked against the per-sample one before it is timed.
+// Build with "make bench", run on the target since that is the number that matters.
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+#include "csv.h"
+#include "decimate.h"
+#include "imu.h"
+#include "imu_block.h"
+#include "wav.h"
+
+static const int kNumPackets = 1 << 16;
+static const int kRepeats = 20;
+static const int kTmstStep = 250; // 4 kHz in 1 us ticks.
+
+static double NowSeconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The unpacking SpiImuReadParse() did before blocks, one struct per packet.
+static void ParseStructs(ImuSample_t* samples, uint8_t* headers, const uint8_t* packets, int num_packets)
+{
+  for (int i = 0; i < num_packets; i++)
+  {
+    const uint8_t* packet = &packets[i * kFifoPacketSize];
+    ImuSample_t sample = {0,
+                          (packet[1] << 8) + packet[2],
+                          (packet[3] << 8) + packet[4],
+                          (packet[5] << 8) + packet[6],
+                          (packet[7] << 8) + packet[8],
+                          (packet[9] << 8) + packet[10],
+                          (packet[11] << 8) + packet[12],
+                          (packet[14] << 8) + packet[15]};
+    headers[i] = packet[0];
+    samples[i] = sample;
+  }
+}
+
+typedef void (*BlockParser_t)(ImuBlock_t* block, const uint8_t* packets, int num_packets);
+
+// Parse the stream in bursts, every block checked against the structs. Returns ns per sample.
+static double BenchParse(const char* name, BlockParser_t parser, const uint8_t* stream, int burst,
+                         const ImuSample_t* expected, const uint8_t* expected_headers)
+{
+  static ImuBlock_t block;
+  for (int first = 0; first < kNumPackets; first += burst)
+  {
+    parser(&block, &stream[first * kFifoPacketSize], burst);
+    for (int i = 0; i < burst; i++)
+    {
+      const ImuSample_t* s = &expected[first + i];
+      const int16_t values[IMU_BLOCK_CHANNELS] = {s->ax, s->ay, s->az, s->gx, s->gy, s->gz};
+      for (int c = 0; c < IMU_BLOCK_CHANNELS; c++)
+        if (block.ch[c][i] != values[c])
+        {
+          printf("ERROR: %s burst %d sample %d channel %d differs\n", name, burst, first + i, c);
+          exit(1);
+        }
+      if (block.tmst[i] != s->tmst || block.header[i] != expected_headers[first + i])
+      {
+        printf("ERROR: %s burst %d sample %d timestamp or header differs\n", name, burst, first + i);
+        exit(1);
+      }
+    }
+  }
+
+  double start = NowSeconds();
+  int64_t checksum = 0;
+  for (int r = 0; r < kRepeats; r++)
+    for (int first = 0; first < kNumPackets; first += burst)
+    {
+      parser(&block, &stream[first * kFifoPacketSize], burst);
+      checksum += block.ch[5][burst - 1];
+    }
+  double elapsed = NowSeconds() - start;
+  if (checksum == 1)
+    printf("\n");
+  return elapsed / ((double)kRepeats * kNumPackets) * 1e9;
+}
+
+static double BenchParseStructs(const uint8_t* stream, int burst)
+{
+  ImuSample_t samples[IMU_BLOCK_CAPACITY];
+  uint8_t headers[IMU_BLOCK_CAPACITY];
+  double start = NowSeconds();
+  int64_t checksum = 0;
+  for (int r = 0; r < kRepeats; r++)
+    for (int first = 0; first < kNumPackets; first += burst)
+    {
+      ParseStructs(samples, headers, &stream[first * kFifoPacketSize], burst);
+      checksum += samples[burst - 1].gz;
+    }
+  double elapsed = NowSeconds() - start;
+  if (checksum == 1)
+    printf("\n");
+  return elapsed / ((double)kRepeats * kNumPackets) * 1e9;
+}
+
+// Everything written to file so far, for comparing outputs. Caller frees.
+static char* ReadBack(FILE* file, long* size)
+{
+  fflush(file);
+  *size = ftell(file);
+  char* data = malloc(*size + 1);
+  rewind(file);
+  if (fread(data, 1, *size, file) != (size_t)*size)
+    *size = -1;
+  return data;
+}
+
+static void CheckSame(const char* name, FILE* a, FILE* b)
+{
+  long size_a, size_b;
+  char* data_a = ReadBack(a, &size_a);
+  char* data_b = ReadBack(b, &size_b);
+  if (size_a != size_b || size_a < 0 || memcmp(data_a, data_b, size_a) != 0)
+  {
+    printf("ERROR: %s output differs between the per-sample and block paths\n", name);
+    exit(1);
+  }
+  free(data_a);
+  free(data_b);
+}
+
+typedef enum { kCsv, kWav, kPlot } Consumer_t;
+
+// One pass of the consumer over the whole stream, per sample or per block. Returns seconds.
+static double RunConsumer(Consumer_t consumer, bool use_blocks, const ImuBlock_t* blocks, int num_blocks,
+                          FILE* out)
+{
+  ImuConfig_t config = gImuConfig;
+  config.odr_hz = 1000000 / kTmstStep;
+  Decimator_t dec;
+  if (consumer == kPlot)
+    DecimatorInitFd(&dec, &config, fileno(out));
+  if (consumer == kWav)
+  {
+    gImuWav = (WavWriter_t){.file = out, .format = kWavInt16, .rate_hz = config.odr_hz};
+  }
+
+  double start = NowSeconds();
+  for (int b = 0; b < num_blocks; b++)
+  {
+    const ImuBlock_t* block = &blocks[b];
+    if (use_blocks)
+    {
+      if (consumer == kCsv)
+        CsvWriteBlock(out, block, NULL);
+      else if (consumer == kWav)
+        WriteWavBlock(block);
+      else
+        DecimatorPushBlock(&dec, block);
+      continue;
+    }
+    for (int i = 0; i < block->num_samples; i++)
+    {
+      const ImuSample_t sample = ImuBlockGetSample(block, i);
+      if (consumer == kCsv)
+        CsvWriteSample(out, &sample, NULL);
+      else if (consumer == kWav)
+        WriteWavSample(&sample);
+      else
+        DecimatorPush(&dec, &sample);
+    }
+  }
+  fflush(out);
+  double elapsed = NowSeconds() - start;
+
+  if (consumer == kPlot)
+  {
+    dec.fd = -1; // Closed with the FILE.
+    DecimatorClose(&dec);
+  }
+  gImuWav.file = NULL;
+  return elapsed;
+}
+
+static void BenchConsumer(const char* name, Consumer_t consumer, const ImuBlock_t* blocks, int num_blocks)
+{
+  FILE* per_sample = tmpfile();
+  FILE* per_block = tmpfile();
+  double sample_s = RunConsumer(consumer, false, blocks, num_blocks, per_sample);
+  double block_s = RunConsumer(consumer, true, blocks, num_blocks, per_block);
+  CheckSame(name, per_sample, per_block);
+  printf("%-10s  %12.1f  %9.1f  %7.1fx\n", name, sample_s / kNumPackets * 1e9, block_s / kNumPackets * 1e9,
+         sample_s / block_s);
+  fclose(per_sample);
+  fclose(per_block);
+}
+
+int main(void)
+{
+  // FIFO packets as the IMU sends them: header, big endian channels, temperature, big endian timestamp.
+  uint8_t* stream = malloc((size_t)kNumPackets * kFifoPacketSize);
+  for (int i = 0; i < kNumPackets; i++)
+  {
+    uint8_t* packet = &stream[i * kFifoPacketSize];
+    packet[0] = kFifoHeaderExpected | (i % 4);
+    for (int byte = 1; byte < kFifoPacketSize; byte++)
+      packet[byte] = rand();
+    const uint16_t tmst = i * kTmstStep;
+    packet[14] = tmst >> 8;
+    packet[15] = tmst;
+  }
+  ImuSample_t* expected = malloc(sizeof(ImuSample_t) * kNumPackets);
+  uint8_t* expected_headers = malloc(kNumPackets);
+  ParseStructs(expected, expected_headers, stream, kNumPackets);
+
+  printf("Parse, ns per sample over %d packets\n", kNumPackets);
+  printf("burst   structs  block scalar  block simd\n");
+  const int bursts[] = {1, kFifoMaxBurstPackets, IMU_BLOCK_CAPACITY};
+  for (size_t b = 0; b < sizeof(bursts) / sizeof(bursts[0]); b++)
+  {
+    const int burst = bursts[b];
+    double structs = BenchParseStructs(stream, burst);
+    double scalar = BenchParse("scalar", ImuBlockParseFifoScalar, stream, burst, expected, expected_headers);
+    double simd = BenchParse("simd", ImuBlockParseFifo, stream, burst, expected, expected_headers);
+    printf("%5d  %8.2f  %12.2f  %10.2f\n", burst, structs, scalar, simd);
+  }
+
+  // Recorder-sized blocks with timestamps, as RecorderService() hands them on.
+  const int num_blocks = kNumPackets / kFifoMaxBurstPackets;
+  ImuBlock_t* blocks = malloc(sizeof(ImuBlock_t) * num_blocks);
+  for (int b = 0; b < num_blocks; b++)
+  {
+    const int first = b * kFifoMaxBurstPackets;
+    ImuBlockParseFifo(&blocks[b], &stream[first * kFifoPacketSize], kFifoMaxBurstPackets);
+    ImuBlockSetTimes(&blocks[b], (int64_t)(first + kFifoMaxBurstPackets - 1) * kTmstStep * 1000);
+  }
+
+  printf("\nConsumers, ns per sample in blocks of %d\n", kFifoMaxBurstPackets);
+  printf("consumer    per-sample   block   speedup\n");
+  BenchConsumer("csv", kCsv, blocks, num_blocks);
+  BenchConsumer("wav int16", kWav, blocks, num_blocks);
+  BenchConsumer("plot", kPlot, blocks, num_blocks);
+
+  free(blocks);
+  free(expected);
+  free(expected_headers);
+  free(stream);
+  return 0;
+}
@@ -0,0 +1,116 @@
+// Per-sample cost and output rate of the live plot decimator, min/max and LTTB.
+// Build with "make bench", run on the target since that is the number that matters.
+#define _DEFAULT_SOURCE
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "decimate.h"
+#include "imu.h"
+
+static const double kSeconds = 120;
+static const int kSpikeEvery = 1487; // Single-sample transients, must all stay visible.
+static const int16_t kSpikeValue = 20000;
+
+static double NowSeconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Count buckets that show a spike, reading the frames back from the output file.
+static int CountVisibleSpikes(FILE* file)
+{
+  rewind(file);
+  int visible = 0;
+  PlotFrameHeader_t header;
+  while (fread(&header, sizeof(header), 1, file) == 1 && header.magic == PLOT_FRAME_MAGIC)
+  {
+    for (int b = 0; b < header.num_buckets; b++)
+    {
+      int16_t pairs[PLOT_CHANNELS][2];
+      if (fread(pairs, sizeof(pairs), 1, file) != 1)
+        return visible;
+      // Spikes are on ax. Min/max: the max. LTTB: the chosen value.
+      if (pairs[0][header.lttb ? 0 : 1] == kSpikeValue)
+        visible++;
+    }
+  }
+  return visible;
+}
+
+// Bytes per sample of the same data as csv text, what a GUI would otherwise read.
+static double CsvBytesPerSample(const ImuSample_t* input, int input_len)
+{
+  long total = 0;
+  for (int i = 0; i < input_len; i++)
+    total += snprintf(NULL, 0, "%f, %d, %d, %d, %d, %d, %d\n", 10.0 + i / 4000.0,
+                      input[i].ax, input[i].ay, input[i].az, input[i].gx, input[i].gy, input[i].gz);
+  return (double)total / input_len;
+}
+
+static void RunBench(int odr_hz, bool lttb, const ImuSample_t* input, int input_len)
+{
+  ImuConfig_t config = gImuConfig;
+  config.odr_hz = odr_hz;
+  config.plot_lttb = lttb;
+
+  FILE* out = tmpfile();
+  Decimator_t dec;
+  DecimatorInitFd(&dec, &config, fileno(out));
+
+  const long num_samples = kSeconds * odr_hz;
+  double start = NowSeconds();
+  for (long i = 0; i < num_samples; i++)
+  {
+    ImuSample_t sample = input[i % input_len];
+    sample.t = (double)i / odr_hz;
+    if (i % kSpikeEvery == kSpikeEvery / 2)
+      sample.ax = kSpikeValue;
+    DecimatorPush(&dec, &sample);
+  }
+  double elapsed = NowSeconds() - start;
+
+  int spikes = (num_samples - kSpikeEvery / 2 - 1) / kSpikeEvery + 1;
+  int visible = CountVisibleSpikes(out);
+  double out_rate = dec.bytes_out / kSeconds;
+  double raw_rate = odr_hz * PLOT_CHANNELS * sizeof(int16_t);
+  double csv_rate = odr_hz * CsvBytesPerSample(input, input_len);
+  printf("%6d  %-7s  %6d  %9.1f  %10.2f  %8.1f  %6.1f  %5d/%d\n",
+         odr_hz, lttb ? "lttb" : "min/max", dec.samples_per_bucket, elapsed / num_samples * 1e9,
+         out_rate / 1e3, raw_rate / out_rate, csv_rate / out_rate, visible, spikes);
+
+  fclose(out);
+  dec.fd = -1; // Closed with the FILE.
+  DecimatorClose(&dec);
+}
+
+int main(void)
+{
+  // Noisy sine on every channel.
+  const int input_len = 4096;
+  ImuSample_t* input = malloc(sizeof(ImuSample_t) * input_len);
+  for (int i = 0; i < input_len; i++)
+  {
+    int16_t v = 8000 * sinf(i * 2 * (float)M_PI / input_len) + rand() % 201 - 100;
+    input[i] = (ImuSample_t){0, v, -v, v / 2, v / 4, -v / 4, v / 8, 0};
+  }
+
+  printf("%.0f s per run, display %d px over %.0f s at %d fps\n",
+         kSeconds, gImuConfig.plot_width, gImuConfig.plot_window_s, gImuConfig.plot_fps);
+  printf("   ODR  mode     bucket  ns/sample  out (kB/s)  vs int16  vs csv  spikes visible\n");
+  for (int odr_hz = 4000; odr_hz <= 32000; odr_hz *= 8)
+  {
+    RunBench(odr_hz, false, input, input_len);
+    RunBench(odr_hz, true, input, input_len);
+  }
+
+  free(input);
+  return 0;
+}
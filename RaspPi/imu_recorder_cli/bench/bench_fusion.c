@@ -0,0 +1,58 @@
+// Per-sample cost of the fusion stage for 1..FUSION_MAX_SENSORS sensors.
+// Build with "make bench", run on the target since that is the number that matters.
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "config.h"
+#include "fusion.h"
+#include "imu.h"
+
+static const int kNumSamples = 1000000;
+
+static double NowSeconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+  // Tilted, stationary sensor with a little noise so the result is checkable.
+  ImuConfig_t config = gImuConfig;
+  config.odr_hz = 32000;
+  ImuSample_t *input = malloc(sizeof(ImuSample_t) * 4096);
+  for (int i = 0; i < 4096; i++)
+    input[i] = (ImuSample_t){0, 1024 + rand() % 9 - 4, -700 + rand() % 9 - 4, 1630 + rand() % 9 - 4,
+                             rand() % 5 - 2, rand() % 5 - 2, rand() % 5 - 2, 0};
+
+  printf("sensors  ns/update  ns/sensor-sample  max ODR (Hz)  |lin_acc| (m/s^2)\n");
+  for (int num_sensors = 1; num_sensors <= FUSION_MAX_SENSORS; num_sensors *= 2)
+  {
+    FusionState_t state;
+    FusionInit(&state, num_sensors, &config);
+    ImuSample_t samples[FUSION_MAX_SENSORS];
+
+    double start = NowSeconds();
+    for (int i = 0; i < kNumSamples; i++)
+    {
+      for (int s = 0; s < num_sensors; s++)
+        samples[s] = input[(i + s) & 4095];
+      FusionUpdate(&state, samples);
+    }
+    double elapsed = NowSeconds() - start;
+
+    FusionOutput_t out = FusionGetOutput(&state, 0);
+    double ns_per_update = elapsed / kNumSamples * 1e9;
+    printf("%7d  %9.1f  %16.1f  %12.0f  %.4f\n",
+           num_sensors, ns_per_update, ns_per_update / num_sensors, 1e9 / ns_per_update,
+           sqrt(out.lin_acc[0] * out.lin_acc[0] + out.lin_acc[1] * out.lin_acc[1] + out.lin_acc[2] * out.lin_acc[2]));
+  }
+
+  free(input);
+  return 0;
+}
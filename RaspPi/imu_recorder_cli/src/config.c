@@ -0,0 +1,443 @@
+#include "config.h"
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Defaults match the values that used to be hard-coded in imu.c and spi.c.
+ImuConfig_t gImuConfig = {
+    .odr_hz = 4000,
+    .accel_fs_g = 16,
+    .gyro_fs_dps = 2000,
+    .spi_speed_hz = 1000000,
+    .force = false,
+    .fusion = false,
+    .trigger = false,
+    .trigger_on_g = 0.05,
+    .trigger_off_g = 0.02,
+    .trigger_pre_s = 0.5,
+    .trigger_post_s = 0.5,
+    .plot_path = "",
+    .plot_width = 800,
+    .plot_fps = 60,
+    .plot_window_s = 20,
+    .plot_lttb = false,
+    .label = "",
+    .daemon_path = "",
+    .wav = kWavOff,
+};
+
+typedef struct {
+  double value;
+  int code;
+} CodeEntry_t;
+
+// See the register reference comments in imu.c.
+static const CodeEntry_t kOdrCodes[] = {
+    {32000, 0b0001}, {16000, 0b0010}, {8000, 0b0011}, {4000, 0b0100},
+    {2000, 0b0101},  {1000, 0b0110},  {500, 0b1111},  {200, 0b0111},
+    {100, 0b1000},   {50, 0b1001},    {25, 0b1010},
+};
+static const CodeEntry_t kAccelFsCodes[] = {
+    {16, 0b000}, {8, 0b001}, {4, 0b010}, {2, 0b011},
+};
+static const CodeEntry_t kGyroFsCodes[] = {
+    {2000, 0b000}, {1000, 0b001}, {500, 0b010},    {250, 0b011},
+    {125, 0b100},  {62.5, 0b101}, {31.25, 0b110}, {15.625, 0b111},
+};
+static const uint32_t kMaxSpiSpeedHz = 24000000;
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+// Returns -1 if value is not in the table.
+static int LookupCode(const CodeEntry_t* table, size_t len, double value)
+{
+  for (size_t i = 0; i < len; i++)
+    if (table[i].value == value)
+      return table[i].code;
+  return -1;
+}
+
+int ConfigOdrCode(const ImuConfig_t* config)
+{
+  return LookupCode(kOdrCodes, ARRAY_LEN(kOdrCodes), config->odr_hz);
+}
+
+int ConfigAccelFsCode(const ImuConfig_t* config)
+{
+  return LookupCode(kAccelFsCodes, ARRAY_LEN(kAccelFsCodes), config->accel_fs_g);
+}
+
+int ConfigGyroFsCode(const ImuConfig_t* config)
+{
+  return LookupCode(kGyroFsCodes, ARRAY_LEN(kGyroFsCodes), config->gyro_fs_dps);
+}
+
+bool ConfigSet(ImuConfig_t* config, const char* key, const char* value)
+{
+  if (strcmp(key, "plot") == 0)
+  {
+    snprintf(config->plot_path, sizeof(config->plot_path), "%s", value);
+    return strlen(value) < sizeof(config->plot_path);
+  }
+  if (strcmp(key, "label") == 0)
+  {
+    snprintf(config->label, sizeof(config->label), "%s", value);
+    return strlen(value) < sizeof(config->label);
+  }
+  if (strcmp(key, "daemon") == 0)
+  {
+    snprintf(config->daemon_path, sizeof(config->daemon_path), "%s", value);
+    return strlen(value) < sizeof(config->daemon_path);
+  }
+  if (strcmp(key, "wav") == 0)
+  {
+    int format = WavParseFormat(value);
+    if (format >= 0)
+      config->wav = format;
+    return format >= 0;
+  }
+
+  char* end;
+  double number = strtod(value, &end);
+  bool is_number = end != value && *end == '\0';
+
+  if (strcmp(key, "odr_hz") == 0 && is_number)
+  {
+    config->odr_hz = (int)number;
+    return ConfigOdrCode(config) != -1;
+  }
+  if (strcmp(key, "accel_fs_g") == 0 && is_number)
+  {
+    config->accel_fs_g = (int)number;
+    return ConfigAccelFsCode(config) != -1;
+  }
+  if (strcmp(key, "gyro_fs_dps") == 0 && is_number)
+  {
+    config->gyro_fs_dps = number;
+    return ConfigGyroFsCode(config) != -1;
+  }
+  if (strcmp(key, "spi_speed_hz") == 0 && is_number)
+  {
+    config->spi_speed_hz = (uint32_t)number;
+    return number > 0 && number <= kMaxSpiSpeedHz;
+  }
+  if (strcmp(key, "force") == 0 && is_number)
+  {
+    config->force = number != 0;
+    return true;
+  }
+  if (strcmp(key, "fusion") == 0 && is_number)
+  {
+    config->fusion = number != 0;
+    return true;
+  }
+  if (strcmp(key, "trigger") == 0 && is_number)
+  {
+    config->trigger = number != 0;
+    return true;
+  }
+  if (strcmp(key, "trigger_on_g") == 0 && is_number)
+  {
+    config->trigger_on_g = number;
+    return number > 0;
+  }
+  if (strcmp(key, "trigger_off_g") == 0 && is_number)
+  {
+    config->trigger_off_g = number;
+    return number > 0;
+  }
+  if (strcmp(key, "trigger_pre_s") == 0 && is_number)
+  {
+    config->trigger_pre_s = number;
+    return number >= 0 && number <= 60;
+  }
+  if (strcmp(key, "trigger_post_s") == 0 && is_number)
+  {
+    config->trigger_post_s = number;
+    return number >= 0;
+  }
+  if (strcmp(key, "plot_width") == 0 && is_number)
+  {
+    config->plot_width = (int)number;
+    return number >= 1 && number <= 10000;
+  }
+  if (strcmp(key, "plot_fps") == 0 && is_number)
+  {
+    config->plot_fps = (int)number;
+    return number >= 1 && number <= 1000;
+  }
+  if (strcmp(key, "plot_window_s") == 0 && is_number)
+  {
+    config->plot_window_s = number;
+    return number > 0;
+  }
+  if (strcmp(key, "plot_lttb") == 0 && is_number)
+  {
+    config->plot_lttb = number != 0;
+    return true;
+  }
+  return false;
+}
+
+// Exits on a bad setting since recording with a half-applied config is worse than not recording.
+static void ConfigSetOrExit(ImuConfig_t* config, const char* key, const char* value, const char* source)
+{
+  if (ConfigSet(config, key, value) == false)
+  {
+    printf("ERROR: Invalid setting \"%s=%s\" in %s\n", key, value, source);
+    exit(1);
+  }
+}
+
+// Strip leading and trailing whitespace in place.
+static char* Trim(char* str)
+{
+  while (*str == ' ' || *str == '\t')
+    str++;
+  char* end = str + strlen(str);
+  while (end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r'))
+    *--end = '\0';
+  return str;
+}
+
+// Config file format is one "key = value" per line, '#' starts a comment.
+int ConfigLoadFile(ImuConfig_t* config, const char* path)
+{
+  FILE* file = fopen(path, "r");
+  if (file == NULL)
+  {
+    perror("Could not open config file");
+    return -1;
+  }
+
+  char line[256];
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    char* comment = strchr(line, '#');
+    if (comment != NULL)
+      *comment = '\0';
+    char* equals = strchr(line, '=');
+    if (equals == NULL)
+      continue;
+    *equals = '\0';
+    ConfigSetOrExit(config, Trim(line), Trim(equals + 1), path);
+  }
+
+  fclose(file);
+  return 0;
+}
+
+static void PrintUsage(const char* program)
+{
+  printf("Usage: %s [options]\n"
+         "  -c, --config FILE   Load \"key = value\" settings from FILE.\n"
+         "  -o, --odr HZ        Output data rate: 25..32000 (default 4000).\n"
+         "  -a, --accel-fs G    Accel full scale: 2, 4, 8, 16 (default 16).\n"
+         "  -g, --gyro-fs DPS   Gyro full scale: 15.625..2000 (default 2000).\n"
+         "  -s, --spi-hz HZ     SPI clock, at most 24000000 (default 1000000).\n"
+         "  -f, --force         Record even if the startup self-check fails.\n"
+         "  -F, --fusion        Add orientation, gravity-free accel, velocity and position columns.\n"
+         "  -t, --trigger       Only save contact episodes, one csv each.\n"
+         "      --trigger-on G  Vibration level in g rms that starts an episode (default 0.05).\n"
+         "      --trigger-off G Level that counts as quiet again (default 0.02).\n"
+         "      --pre S         Seconds kept before the trigger (default 0.5).\n"
+         "      --post S        Quiet seconds before an episode ends (default 0.5).\n"
+         "  -p, --plot PATH     Write decimated live plot frames to PATH, e.g. a named pipe.\n"
+         "      --plot-width PX Display columns, one min/max bucket each (default 800).\n"
+         "      --plot-fps FPS  Frames per second (default 60).\n"
+         "      --plot-window S Seconds across the display (default 20).\n"
+         "      --lttb          One LTTB point per column instead of min/max.\n"
+         "  -l, --label NAME    Name files NAME_001.csv, NAME_002.csv... instead of by date.\n"
+         "  -d, --daemon SOCKET Wait for commands on a Unix socket instead of the terminal.\n"
+         "  -w, --wav FORMAT    Also write a wav per csv: int16 (native ODR) or float (48kHz).\n"
+         "Config file keys: odr_hz, accel_fs_g, gyro_fs_dps, spi_speed_hz, force, fusion,\n"
+         "  trigger, trigger_on_g, trigger_off_g, trigger_pre_s, trigger_post_s,\n"
+         "  plot, plot_width, plot_fps, plot_window_s, plot_lttb, label, daemon, wav.\n",
+         program);
+}
+
+// getopt values for long-only options.
+enum {
+  kOptTriggerOn = 256,
+  kOptTriggerOff,
+  kOptPre,
+  kOptPost,
+  kOptPlotWidth,
+  kOptPlotFps,
+  kOptPlotWindow,
+  kOptLttb,
+};
+
+// Command line settings override config file settings regardless of argument order.
+void ConfigParseArgs(ImuConfig_t* config, int argc, char** argv)
+{
+  static const struct option kLongOptions[] = {
+      {"config", required_argument, NULL, 'c'},
+      {"odr", required_argument, NULL, 'o'},
+      {"accel-fs", required_argument, NULL, 'a'},
+      {"gyro-fs", required_argument, NULL, 'g'},
+      {"spi-hz", required_argument, NULL, 's'},
+      {"force", no_argument, NULL, 'f'},
+      {"fusion", no_argument, NULL, 'F'},
+      {"trigger", no_argument, NULL, 't'},
+      {"trigger-on", required_argument, NULL, kOptTriggerOn},
+      {"trigger-off", required_argument, NULL, kOptTriggerOff},
+      {"pre", required_argument, NULL, kOptPre},
+      {"post", required_argument, NULL, kOptPost},
+      {"plot", required_argument, NULL, 'p'},
+      {"plot-width", required_argument, NULL, kOptPlotWidth},
+      {"plot-fps", required_argument, NULL, kOptPlotFps},
+      {"plot-window", required_argument, NULL, kOptPlotWindow},
+      {"lttb", no_argument, NULL, kOptLttb},
+      {"label", required_argument, NULL, 'l'},
+      {"daemon", required_argument, NULL, 'd'},
+      {"wav", required_argument, NULL, 'w'},
+      {"help", no_argument, NULL, 'h'},
+      {0},
+  };
+
+  // Hold argv settings until the config file is loaded.
+  const char* config_path = NULL;
+  const char* keys[32];
+  const char* values[32];
+  int num_settings = 0;
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "c:o:a:g:s:fFtp:l:d:w:h", kLongOptions, NULL)) != -1)
+  {
+    const char* key = NULL;
+    switch (opt)
+    {
+    case 'c':
+      config_path = optarg;
+      continue;
+    case 'o':
+      key = "odr_hz";
+      break;
+    case 'a':
+      key = "accel_fs_g";
+      break;
+    case 'g':
+      key = "gyro_fs_dps";
+      break;
+    case 's':
+      key = "spi_speed_hz";
+      break;
+    case 'f':
+      key = "force";
+      optarg = "1";
+      break;
+    case 'F':
+      key = "fusion";
+      optarg = "1";
+      break;
+    case 't':
+      key = "trigger";
+      optarg = "1";
+      break;
+    case kOptTriggerOn:
+      key = "trigger_on_g";
+      break;
+    case kOptTriggerOff:
+      key = "trigger_off_g";
+      break;
+    case kOptPre:
+      key = "trigger_pre_s";
+      break;
+    case kOptPost:
+      key = "trigger_post_s";
+      break;
+    case 'p':
+      key = "plot";
+      break;
+    case kOptPlotWidth:
+      key = "plot_width";
+      break;
+    case kOptPlotFps:
+      key = "plot_fps";
+      break;
+    case kOptPlotWindow:
+      key = "plot_window_s";
+      break;
+    case kOptLttb:
+      key = "plot_lttb";
+      optarg = "1";
+      break;
+    case 'l':
+      key = "label";
+      break;
+    case 'd':
+      key = "daemon";
+      break;
+    case 'w':
+      key = "wav";
+      break;
+    case 'h':
+      PrintUsage(argv[0]);
+      exit(0);
+    default:
+      PrintUsage(argv[0]);
+      exit(1);
+    }
+    if (num_settings < (int)ARRAY_LEN(keys))
+    {
+      keys[num_settings] = key;
+      values[num_settings] = optarg;
+      num_settings++;
+    }
+  }
+
+  if (config_path != NULL && ConfigLoadFile(config, config_path) != 0)
+    exit(1);
+  for (int i = 0; i < num_settings; i++)
+    ConfigSetOrExit(config, keys[i], values[i], "command line");
+
+  if (ConfigCheck(config) == false)
+    exit(1);
+}
+
+bool ConfigCheck(const ImuConfig_t* config)
+{
+  if (config->trigger_off_g > config->trigger_on_g)
+  {
+    printf("ERROR: trigger_off_g must not be above trigger_on_g\n");
+    return false;
+  }
+  return true;
+}
+
+void ConfigWriteHeader(FILE* file, const ImuConfig_t* config)
+{
+  fprintf(file,
+          "# odr_hz=%d\n"
+          "# accel_fs_g=%d\n"
+          "# gyro_fs_dps=%g\n"
+          "# spi_speed_hz=%u\n"
+          "# fusion=%d\n"
+          "# trigger=%d\n"
+          "# trigger_on_g=%g\n"
+          "# trigger_off_g=%g\n"
+          "# trigger_pre_s=%g\n"
+          "# trigger_post_s=%g\n"
+          "# accel_config0=0x%02x\n"
+          "# gyro_config0=0x%02x\n",
+          config->odr_hz,
+          config->accel_fs_g,
+          config->gyro_fs_dps,
+          config->spi_speed_hz,
+          config->fusion,
+          config->trigger,
+          config->trigger_on_g,
+          config->trigger_off_g,
+          config->trigger_pre_s,
+          config->trigger_post_s,
+          (ConfigAccelFsCode(config) << 5) | ConfigOdrCode(config),
+          (ConfigGyroFsCode(config) << 5) | ConfigOdrCode(config));
+  if (config->label[0] != '\0')
+    fprintf(file, "# label=%s\n", config->label);
+  if (config->wav != kWavOff)
+    fprintf(file, "# wav=%s\n", WavFormatName(config->wav));
+}
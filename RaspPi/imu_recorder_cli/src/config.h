@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "wav.h"
+
+// Recording settings, filled from defaults, then an optional config file, then argv.
+typedef struct {
+  int odr_hz;            // Accel and gyro output data rate.
+  int accel_fs_g;        // Accel full scale in +-g.
+  double gyro_fs_dps;    // Gyro full scale in +-dps.
+  uint32_t spi_speed_hz; // SPI clock, the IMU supports up to 24MHz.
+  bool force;            // Record even if the startup self-check fails.
+  bool fusion;           // Add orientation, linear accel, velocity and position columns.
+  bool trigger;          // Only keep contact episodes, see trigger.h.
+  double trigger_on_g;   // Vibration level (g rms) that starts an episode.
+  double trigger_off_g;  // Level below which the post-trigger countdown runs.
+  double trigger_pre_s;  // Context kept before the trigger.
+  double trigger_post_s; // Quiet time after contact before the episode ends.
+  char plot_path[256];   // Live plot frames are written here, see decimate.h. Empty for none.
+  int plot_width;        // Display columns across the plot window.
+  int plot_fps;          // Display refresh rate, one frame each.
+  double plot_window_s;  // Seconds across the display.
+  bool plot_lttb;        // One LTTB point per column instead of min/max.
+  char label[64];        // Session label, e.g. "surface/grit". Names the files instead of the date.
+  char daemon_path[108]; // Run as a daemon controlled over this Unix socket, see daemon.h.
+  WavFormat_t wav;       // Also write each csv as a 6 channel wav, see wav.h.
+} ImuConfig_t;
+
+extern ImuConfig_t gImuConfig;
+
+void ConfigParseArgs(ImuConfig_t* config, int argc, char** argv);
+int ConfigLoadFile(ImuConfig_t* config, const char* path);
+// Apply one "key=value" setting. Returns false on an unknown key or bad value.
+bool ConfigSet(ImuConfig_t* config, const char* key, const char* value);
+// Checks across settings. Prints the problem and returns false.
+bool ConfigCheck(const ImuConfig_t* config);
+
+// Register codes for ACCEL_CONFIG0 and GYRO_CONFIG0.
+int ConfigOdrCode(const ImuConfig_t* config);
+int ConfigAccelFsCode(const ImuConfig_t* config);
+int ConfigGyroFsCode(const ImuConfig_t* config);
+
+// Print the settings as "# key=value" lines at the top of a recording.
+void ConfigWriteHeader(FILE* file, const ImuConfig_t* config);
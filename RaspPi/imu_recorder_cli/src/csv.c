@@ -1,23 +1,28 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include "csv.h"
+#include "imu.h"
 
 #include <signal.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
 
 FILE *gImuCsvFd = NULL;
+WavWriter_t gImuWav = {0};
+static const char kRecordingDirName[] = "imu_recordings_dir";
+static const char kFusionFormat[] =
+    ", %.6f, %.6f, %.6f, %.6f, %.5f, %.5f, %.5f, %.6f, %.6f, %.6f, %.7f, %.7f, %.7f";
 
 // Perform a safe exit that flushes the csv file.
 void SafeExit()
 {
   if (gImuCsvFd != NULL)
   {
-    fclose(gImuCsvFd); // Close the file
-    gImuCsvFd = NULL; // Make sure the file cant be closed again.
+    CloseCsv();
     printf("\nFile closed.\n");
   }
   printf("Exiting Program.\n");
@@ -41,26 +46,219 @@ void SigIntHandlerSetup()
     perror("Failed to set SIGINT handler");
 }
 
-FILE *OpenNewCsv()
+// True if imu_recordings_dir/<name><suffix>.csv exists.
+static bool CsvExists(const char *name, const char *suffix)
 {
-  // Get formatted date and time.
-  time_t now = time(NULL);
-  char date_str[20];
-  strftime(date_str, sizeof(date_str), "%Y-%m-%d_%H-%M-%S", localtime(&now));
+  char file_name[200];
+  snprintf(file_name, sizeof(file_name), "%s/%s%s.csv", kRecordingDirName, name, suffix);
+  return access(file_name, F_OK) == 0;
+}
 
+// Session names look like "recording_2026-03-17_14-05-09", or "surface-grit_003" for label "surface/grit".
+// Labelled sessions are numbered after the last existing file, so back-to-back sessions never collide.
+void CsvNewSessionName(char *name, size_t size, const char *label)
+{
+  if (label == NULL || label[0] == '\0')
+  {
+    // Get formatted date and time.
+    time_t now = time(NULL);
+    char date_str[20];
+    strftime(date_str, sizeof(date_str), "%Y-%m-%d_%H-%M-%S", localtime(&now));
+    snprintf(name, size, "recording_%s", date_str);
+    return;
+  }
+
+  // Keep labels file name safe, "/" and spaces become "-".
+  char base[64];
+  size_t len = 0;
+  for (; label[len] != '\0' && len < sizeof(base) - 1; len++)
+  {
+    char c = label[len];
+    bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.' || c == '-';
+    base[len] = safe ? c : '-';
+  }
+  base[len] = '\0';
+
+  for (int index = 1;; index++)
+  {
+    snprintf(name, size, "%s_%03d", base, index);
+    if (CsvExists(name, "") == false && CsvExists(name, "_episodes") == false && CsvExists(name, "_ep001") == false)
+      return;
+  }
+}
+
+// Open imu_recordings_dir/<name>.csv with the given fopen mode.
+static FILE *OpenCsvMode(const char *name, const char *mode)
+{
   // Check for proper recording directory.
   // This is a possible termination point.
-  const char recording_dir_name[50] = "imu_recordings_dir";
-  if (access(recording_dir_name, F_OK) == -1)
+  if (access(kRecordingDirName, F_OK) == -1)
   {
-    printf("ERROR: There is no dir called \"%s/\"\n", recording_dir_name);
+    printf("ERROR: There is no dir called \"%s/\"\n", kRecordingDirName);
     exit(1);
   }
 
   // Concatenate to final file name.
   char file_name[200];
-  snprintf(file_name, sizeof(file_name), "%s/recording_%s.csv", recording_dir_name, date_str);
+  snprintf(file_name, sizeof(file_name), "%s/%s.csv", kRecordingDirName, name);
 
   // Open file and return fd.
-  return fopen(file_name, "w");
-}
\ No newline at end of file
+  return fopen(file_name, mode);
+}
+
+FILE *OpenCsv(const char *name)
+{
+  return OpenCsvMode(name, "w");
+}
+
+FILE *OpenCsvAppend(const char *name)
+{
+  return OpenCsvMode(name, "a");
+}
+
+FILE *OpenNewCsv()
+{
+  char name[64];
+  CsvNewSessionName(name, sizeof(name), NULL);
+  return OpenCsv(name);
+}
+
+// Append the recording's validity counters and close the file.
+void CloseCsv()
+{
+  CloseCsvWithStats(&gImuReadStats);
+}
+
+void CloseCsvWithStats(const ImuReadStats_t *stats)
+{
+  ImuWriteStats(gImuCsvFd, stats);
+  fclose(gImuCsvFd); // Close the file
+  gImuCsvFd = NULL; // Make sure the file cant be closed again.
+  // Patch the wav sizes now that the segment is complete.
+  if (gImuWav.file != NULL && WavClose(&gImuWav) != 0)
+    perror("Failed to finish wav file");
+}
+
+void OpenWav(const char *name, const ImuConfig_t *config)
+{
+  if (config->wav == kWavOff)
+    return;
+  char file_name[200];
+  snprintf(file_name, sizeof(file_name), "%s/%s.wav", kRecordingDirName, name);
+  // Recording carries on with the csv alone if the wav can't be opened.
+  if (WavOpen(&gImuWav, file_name, config->wav, config->odr_hz) != 0)
+    perror("Failed to open wav file");
+}
+
+void WriteWavSample(const ImuSample_t *sample)
+{
+  const int16_t counts[WAV_CHANNELS] = {sample->ax, sample->ay, sample->az, sample->gx, sample->gy, sample->gz};
+  WavWriteSample(&gImuWav, counts);
+}
+
+void WriteWavBlock(const ImuBlock_t *block)
+{
+  const int16_t *const channels[WAV_CHANNELS] = {block->ch[0], block->ch[1], block->ch[2],
+                                                 block->ch[3], block->ch[4], block->ch[5]};
+  WavWriteChannels(&gImuWav, channels, block->num_samples);
+}
+
+void CsvWriteColumnNames(FILE *file, const ImuConfig_t *config)
+{
+  fprintf(file, "Time, ax, ay, az, gx, gy, gz");
+  if (config->fusion)
+    fprintf(file, ", qw, qx, qy, qz, lax, lay, laz, vx, vy, vz, px, py, pz");
+  fprintf(file, "\n");
+}
+
+// Returns the number of characters written.
+int CsvWriteSample(FILE *file, const ImuSample_t *sample, const FusionOutput_t *fusion)
+{
+  int chars_printed = fprintf(file, "%f, %d, %d, %d, %d, %d, %d",
+                              sample->t,
+                              sample->ax, sample->ay, sample->az,
+                              sample->gx, sample->gy, sample->gz);
+  if (fusion != NULL)
+    chars_printed += fprintf(file, kFusionFormat,
+                             fusion->q[0], fusion->q[1], fusion->q[2], fusion->q[3],
+                             fusion->lin_acc[0], fusion->lin_acc[1], fusion->lin_acc[2],
+                             fusion->vel[0], fusion->vel[1], fusion->vel[2],
+                             fusion->pos[0], fusion->pos[1], fusion->pos[2]);
+  chars_printed += fprintf(file, "\n");
+  return chars_printed;
+}
+
+// Decimal digits of value, most significant first.
+static char *FormatUnsigned(char *p, uint64_t value)
+{
+  char digits[20];
+  int n = 0;
+  do
+  {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+  while (n > 0)
+    *p++ = digits[--n];
+  return p;
+}
+
+static char *FormatInt(char *p, int value)
+{
+  if (value < 0)
+  {
+    *p++ = '-';
+    return FormatUnsigned(p, -(int64_t)value);
+  }
+  return FormatUnsigned(p, value);
+}
+
+// Seconds with 6 decimals like "%f".
+static char *FormatSeconds(char *p, int64_t t_ns)
+{
+  if (t_ns < 0)
+  {
+    *p++ = '-';
+    t_ns = -t_ns;
+  }
+  const uint64_t us = (t_ns + 500) / 1000;
+  p = FormatUnsigned(p, us / 1000000);
+  *p++ = '.';
+  uint32_t frac = us % 1000000;
+  for (int i = 5; i >= 0; i--, frac /= 10)
+    p[i] = '0' + frac % 10;
+  return p + 6;
+}
+
+int CsvWriteBlock(FILE *file, const ImuBlock_t *block, const FusionOutput_t *fusion)
+{
+  // Room for several rows, flushed before a row with fusion columns could overflow it.
+  char text[4096];
+  const size_t kMaxRow = 512;
+  char *p = text;
+  int chars_printed = 0;
+  for (int i = 0; i < block->num_samples; i++)
+  {
+    p = FormatSeconds(p, block->t_ns[i]);
+    for (int c = 0; c < IMU_BLOCK_CHANNELS; c++)
+    {
+      *p++ = ',';
+      *p++ = ' ';
+      p = FormatInt(p, block->ch[c][i]);
+    }
+    if (fusion != NULL)
+    {
+      const FusionOutput_t *f = &fusion[i];
+      p += snprintf(p, kMaxRow, kFusionFormat, f->q[0], f->q[1], f->q[2], f->q[3],
+                    f->lin_acc[0], f->lin_acc[1], f->lin_acc[2],
+                    f->vel[0], f->vel[1], f->vel[2], f->pos[0], f->pos[1], f->pos[2]);
+    }
+    *p++ = '\n';
+    if ((size_t)(text + sizeof(text) - p) < kMaxRow || i == block->num_samples - 1)
+    {
+      chars_printed += fwrite(text, 1, p - text, file);
+      p = text;
+    }
+  }
+  return chars_printed;
+}
@@ -1,11 +1,36 @@
 #pragma once
 
 #include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
 
+#include "config.h"
+#include "fusion.h"
+#include "imu.h"
+#include "imu_block.h"
+#include "wav.h"
+
 extern FILE* gImuCsvFd;
+// Wav twin of gImuCsvFd when config->wav is set, closed together with it.
+extern WavWriter_t gImuWav;
 
 void SigIntRoutine(int signal);
 void SafeExit();
 void SigIntHandlerSetup();
+void CsvNewSessionName(char* name, size_t size, const char* label);
+FILE* OpenCsv(const char* name);
+FILE* OpenCsvAppend(const char* name);
 FILE* OpenNewCsv();
+void CloseCsv();
+// Same, with the counters to append instead of the whole session's.
+void CloseCsvWithStats(const ImuReadStats_t* stats);
+// Open imu_recordings_dir/<name>.wav if config->wav is set.
+void OpenWav(const char* name, const ImuConfig_t* config);
+void WriteWavSample(const ImuSample_t* sample);
+void WriteWavBlock(const ImuBlock_t* block);
+void CsvWriteColumnNames(FILE* file, const ImuConfig_t* config);
+// fusion may be NULL when fusion columns are disabled.
+int CsvWriteSample(FILE* file, const ImuSample_t* sample, const FusionOutput_t* fusion);
+// Same rows for a whole block, formatted without printf and written in one go. fusion is NULL or
+// has block->num_samples entries. Times are t_ns rounded to the microsecond.
+int CsvWriteBlock(FILE* file, const ImuBlock_t* block, const FusionOutput_t* fusion);
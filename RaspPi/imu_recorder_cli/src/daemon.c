@@ -0,0 +1,355 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "daemon.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "imu_time.h"
+#include "libgpiod_imu_interrupt.h"
+#include "recorder.h"
+#include "selfcheck.h"
+#include "spi.h"
+
+enum {
+  kMaxClients = 4,
+  kLineSize = 512,
+};
+
+typedef struct {
+  int fd; // -1 for a free slot.
+  char line[kLineSize];
+  int len;
+} DaemonClient_t;
+
+typedef struct {
+  ImuConfig_t* config;
+  Recorder_t recorder;
+  DaemonClient_t clients[kMaxClients];
+  bool quit;
+  double stop_at; // Monotonic time the running session ends, 0 for none.
+
+  // Scheduled sessions.
+  int runs_left;
+  double run_s, gap_s;
+  double next_start_at;
+} Daemon_t;
+
+static double Seconds(timespec ts)
+{
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void DaemonStart(Daemon_t* daemon, const timespec* command_time, double seconds)
+{
+  // Edges that queued while idle belong to samples the FIFO flush drops.
+  GpioDrainEvents();
+  RecorderStart(&daemon->recorder, daemon->config, command_time);
+  daemon->stop_at = seconds > 0 ? Seconds(*command_time) + seconds : 0;
+  printf("Recording %s...\n", daemon->recorder.session_name);
+}
+
+static void DaemonStop(Daemon_t* daemon)
+{
+  RecorderStop(&daemon->recorder);
+  daemon->stop_at = 0;
+  printf("RECORDING ENDED\n\n");
+}
+
+// Settings that need the IMU registers or SPI clock rewritten.
+static bool NeedsReconfigure(const ImuConfig_t* a, const ImuConfig_t* b)
+{
+  return a->odr_hz != b->odr_hz || a->accel_fs_g != b->accel_fs_g || a->gyro_fs_dps != b->gyro_fs_dps ||
+         a->spi_speed_hz != b->spi_speed_hz;
+}
+
+static void DaemonConfigure(Daemon_t* daemon, int fd, char* args)
+{
+  if (daemon->recorder.recording)
+  {
+    dprintf(fd, "error stop the session first\n");
+    return;
+  }
+
+  ImuConfig_t config = *daemon->config;
+  char* save;
+  for (char* token = strtok_r(args, " \t", &save); token != NULL; token = strtok_r(NULL, " \t", &save))
+  {
+    char* equals = strchr(token, '=');
+    if (equals == NULL)
+    {
+      dprintf(fd, "error expected key=value, got \"%s\"\n", token);
+      return;
+    }
+    *equals = '\0';
+    if (ConfigSet(&config, token, equals + 1) == false)
+    {
+      dprintf(fd, "error invalid setting \"%s=%s\"\n", token, equals + 1);
+      return;
+    }
+  }
+  if (ConfigCheck(&config) == false)
+  {
+    dprintf(fd, "error inconsistent settings, see the daemon log\n");
+    return;
+  }
+
+  // Same rule as at startup, refuse rates the pipeline can't keep up with unless forced.
+  if (NeedsReconfigure(daemon->config, &config))
+  {
+    SpiImuConfigure(&config);
+    if (SelfCheckPipeline(&config) == false && config.force == false)
+    {
+      SpiImuConfigure(daemon->config);
+      dprintf(fd, "error self-check failed, add force=1 to record anyway\n");
+      return;
+    }
+  }
+  *daemon->config = config;
+  dprintf(fd, "ok\n");
+}
+
+static void DaemonCommand(Daemon_t* daemon, int fd, char* line, const timespec* received)
+{
+  Recorder_t* rec = &daemon->recorder;
+  char* save;
+  char* command = strtok_r(line, " \t", &save);
+  char* args = strtok_r(NULL, "", &save);
+  if (args == NULL)
+    args = "";
+  if (command == NULL)
+    return;
+
+  if (strcmp(command, "start") == 0)
+  {
+    if (rec->recording)
+    {
+      dprintf(fd, "error already recording %s\n", rec->session_name);
+      return;
+    }
+    DaemonStart(daemon, received, atof(args));
+    dprintf(fd, "ok %s\n", rec->session_name);
+  }
+  else if (strcmp(command, "stop") == 0)
+  {
+    if (rec->recording == false && daemon->runs_left == 0)
+    {
+      dprintf(fd, "error not recording\n");
+      return;
+    }
+    daemon->runs_left = 0;
+    if (rec->recording)
+      DaemonStop(daemon);
+    dprintf(fd, "ok %s samples=%llu\n", rec->session_name, (unsigned long long)rec->num_samples);
+  }
+  else if (strcmp(command, "label") == 0)
+  {
+    // Applies to the next session, a running one keeps its name.
+    if (ConfigSet(daemon->config, "label", args) == false)
+    {
+      dprintf(fd, "error label too long\n");
+      return;
+    }
+    dprintf(fd, "ok\n");
+  }
+  else if (strcmp(command, "configure") == 0)
+  {
+    DaemonConfigure(daemon, fd, args);
+  }
+  else if (strcmp(command, "schedule") == 0)
+  {
+    int count = 0;
+    double run_s = 0, gap_s = 0;
+    if (sscanf(args, "%d %lf %lf", &count, &run_s, &gap_s) < 2 || count < 1 || run_s <= 0 || gap_s < 0)
+    {
+      dprintf(fd, "error usage: schedule COUNT SECONDS [GAP_S]\n");
+      return;
+    }
+    if (rec->recording)
+    {
+      dprintf(fd, "error stop the session first\n");
+      return;
+    }
+    daemon->runs_left = count;
+    daemon->run_s = run_s;
+    daemon->gap_s = gap_s;
+    daemon->next_start_at = Seconds(*received);
+    dprintf(fd, "ok\n");
+  }
+  else if (strcmp(command, "status") == 0)
+  {
+    timespec now;
+    GetMonotonic(&now);
+    dprintf(fd, "ok %s session=%s samples=%llu elapsed_s=%.3f start_latency_ms=%.3f runs_left=%d label=%s\n",
+            rec->recording ? "recording" : "idle",
+            rec->session_name[0] != '\0' ? rec->session_name : "-",
+            (unsigned long long)rec->num_samples,
+            rec->recording ? TimespecDiff(rec->command_time, now) : 0.0,
+            rec->start_latency_s * 1e3,
+            daemon->runs_left,
+            daemon->config->label[0] != '\0' ? daemon->config->label : "-");
+  }
+  else if (strcmp(command, "quit") == 0)
+  {
+    daemon->runs_left = 0;
+    if (rec->recording)
+      DaemonStop(daemon);
+    daemon->quit = true;
+    dprintf(fd, "ok\n");
+  }
+  else
+  {
+    dprintf(fd, "error unknown command \"%s\"\n", command);
+  }
+}
+
+static void DaemonCloseClient(DaemonClient_t* client)
+{
+  close(client->fd);
+  client->fd = -1;
+  client->len = 0;
+}
+
+// Run every complete line the client has sent.
+static void DaemonReadClient(Daemon_t* daemon, DaemonClient_t* client, const timespec* received)
+{
+  ssize_t num_read = read(client->fd, client->line + client->len, kLineSize - 1 - client->len);
+  if (num_read == 0 || (num_read < 0 && errno != EAGAIN && errno != EINTR))
+  {
+    DaemonCloseClient(client);
+    return;
+  }
+  if (num_read < 0)
+    return;
+  client->len += num_read;
+  client->line[client->len] = '\0';
+
+  char* newline;
+  while (client->fd >= 0 && (newline = strchr(client->line, '\n')) != NULL)
+  {
+    *newline = '\0';
+    if (newline > client->line && newline[-1] == '\r')
+      newline[-1] = '\0';
+    DaemonCommand(daemon, client->fd, client->line, received);
+    int consumed = newline + 1 - client->line;
+    client->len -= consumed;
+    memmove(client->line, newline + 1, client->len + 1);
+  }
+  if (client->len == kLineSize - 1)
+  {
+    dprintf(client->fd, "error line too long\n");
+    client->len = 0;
+  }
+}
+
+static void DaemonAccept(Daemon_t* daemon, int listen_fd)
+{
+  int fd = accept(listen_fd, NULL, NULL);
+  if (fd < 0)
+    return;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  for (int i = 0; i < kMaxClients; i++)
+  {
+    if (daemon->clients[i].fd < 0)
+    {
+      daemon->clients[i].fd = fd;
+      daemon->clients[i].len = 0;
+      return;
+    }
+  }
+  dprintf(fd, "error too many clients\n");
+  close(fd);
+}
+
+int DaemonRun(ImuConfig_t* config, const char* socket_path)
+{
+  static Daemon_t daemon;
+  daemon.config = config;
+  for (int i = 0; i < kMaxClients; i++)
+    daemon.clients[i].fd = -1;
+  // A client that hangs up before its reply must not kill the recorder.
+  signal(SIGPIPE, SIG_IGN);
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+  unlink(socket_path);
+  if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 ||
+      listen(listen_fd, kMaxClients) == -1)
+  {
+    perror("Could not open control socket");
+    return 1;
+  }
+  printf("Waiting for commands on %s\n", socket_path);
+
+  const int gpio_fd = GpioGetFd();
+  while (daemon.quit == false)
+  {
+    // The interrupt line is only watched while recording, idle edges stay queued in the kernel.
+    struct pollfd fds[2 + kMaxClients];
+    fds[0] = (struct pollfd){.fd = daemon.recorder.recording ? gpio_fd : -1, .events = POLLIN};
+    fds[1] = (struct pollfd){.fd = listen_fd, .events = POLLIN};
+    for (int i = 0; i < kMaxClients; i++)
+      fds[2 + i] = (struct pollfd){.fd = daemon.clients[i].fd, .events = POLLIN};
+
+    // Sleep until an edge, a command, or the next timed stop or scheduled start.
+    timespec now;
+    GetMonotonic(&now);
+    double next_event = 0;
+    if (daemon.recorder.recording && daemon.stop_at > 0)
+      next_event = daemon.stop_at;
+    else if (daemon.recorder.recording == false && daemon.runs_left > 0)
+      next_event = daemon.next_start_at;
+    int timeout_ms = -1;
+    if (next_event > 0)
+      timeout_ms = next_event > Seconds(now) ? (int)ceil((next_event - Seconds(now)) * 1000) : 0;
+
+    if (poll(fds, 2 + kMaxClients, timeout_ms) == -1 && errno != EINTR)
+    {
+      perror("poll failed");
+      break;
+    }
+    timespec received;
+    GetMonotonic(&received);
+
+    // Samples first, they are the only hard deadline.
+    if ((fds[0].revents & POLLIN) && GpioGetEvent())
+      RecorderService(&daemon.recorder);
+
+    // Timed stop, then the next scheduled session.
+    if (daemon.recorder.recording && daemon.stop_at > 0 && Seconds(received) >= daemon.stop_at)
+    {
+      DaemonStop(&daemon);
+      daemon.next_start_at = Seconds(received) + daemon.gap_s;
+    }
+    if (daemon.recorder.recording == false && daemon.runs_left > 0 && Seconds(received) >= daemon.next_start_at)
+    {
+      daemon.runs_left--;
+      DaemonStart(&daemon, &received, daemon.run_s);
+    }
+
+    if (fds[1].revents & POLLIN)
+      DaemonAccept(&daemon, listen_fd);
+    for (int i = 0; i < kMaxClients; i++)
+      if (daemon.clients[i].fd >= 0 && (fds[2 + i].revents & (POLLIN | POLLHUP | POLLERR)))
+        DaemonReadClient(&daemon, &daemon.clients[i], &received);
+  }
+
+  for (int i = 0; i < kMaxClients; i++)
+    if (daemon.clients[i].fd >= 0)
+      DaemonCloseClient(&daemon.clients[i]);
+  close(listen_fd);
+  unlink(socket_path);
+  return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "config.h"
+
+// Daemon mode: SPI, GPIO and priority stay set up between sessions and commands arrive on a
+// Unix stream socket, one text line each. Every command gets one reply line, "ok ..." or "error ...".
+//
+//   start [SECONDS]                 Start a session now, optionally stopping after SECONDS.
+//   stop                            Stop the session and cancel the schedule.
+//   label TEXT                      Label for the next sessions, files become TEXT_001.csv, ...
+//   configure KEY=VALUE ...         Change settings while idle, same keys as the config file.
+//   schedule COUNT SECONDS [GAP_S]  Record COUNT sessions of SECONDS each, GAP_S apart.
+//   status                          State, session, samples and command-to-first-sample latency.
+//   quit                            Stop and exit.
+//
+// e.g. echo "label surface/grit" | socat - UNIX-CONNECT:/tmp/imu.sock
+int DaemonRun(ImuConfig_t* config, const char* socket_path);
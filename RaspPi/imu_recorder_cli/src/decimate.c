@@ -0,0 +1,277 @@
+#include "decimate.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "imu.h"
+#include "imu_block.h"
+
+// Frames up to PIPE_BUF are written atomically to a pipe, so a slow reader never sees half a frame.
+static const int kMaxBucketsPerFrame =
+    (PIPE_BUF - sizeof(PlotFrameHeader_t)) / (sizeof(int16_t) * 2 * PLOT_CHANNELS);
+
+static void* AllocOrExit(size_t size)
+{
+  void* ptr = calloc(1, size);
+  if (ptr == NULL)
+  {
+    printf("ERROR: Could not allocate %zu bytes for the plot decimator\n", size);
+    exit(1);
+  }
+  return ptr;
+}
+
+void DecimatorInitFd(Decimator_t* dec, const ImuConfig_t* config, int fd)
+{
+  memset(dec, 0, sizeof(*dec));
+  dec->fd = fd;
+  dec->lttb = config->plot_lttb;
+  dec->samples_per_bucket = lround(config->odr_hz * config->plot_window_s / config->plot_width);
+  if (dec->samples_per_bucket < 1)
+    dec->samples_per_bucket = 1;
+  dec->samples_per_frame = config->odr_hz / config->plot_fps;
+  if (dec->samples_per_frame < 1)
+    dec->samples_per_frame = 1;
+  dec->bucket_s = (float)dec->samples_per_bucket / config->odr_hz;
+
+  // Room for a frame's worth of buckets, plus one for rounding.
+  dec->out_capacity = dec->samples_per_frame / dec->samples_per_bucket + 2;
+  dec->out = AllocOrExit(sizeof(*dec->out) * dec->out_capacity);
+  if (dec->lttb)
+  {
+    dec->current = AllocOrExit(sizeof(*dec->current) * dec->samples_per_bucket);
+    dec->pending = AllocOrExit(sizeof(*dec->pending) * dec->samples_per_bucket);
+  }
+}
+
+bool DecimatorInit(Decimator_t* dec, const ImuConfig_t* config, const char* path)
+{
+  // A reader that goes away must not kill the recorder.
+  signal(SIGPIPE, SIG_IGN);
+  int fd = open(path, O_WRONLY | O_NONBLOCK | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+  {
+    // ENXIO is a named pipe without a reader.
+    printf("WARNING: No live plot, could not open %s: %s\n", path, strerror(errno));
+    memset(dec, 0, sizeof(*dec));
+    dec->fd = -1;
+    return false;
+  }
+  DecimatorInitFd(dec, config, fd);
+  return true;
+}
+
+// Write the completed buckets as one or more frames. Frames that don't fit in the pipe are dropped.
+static void DecimatorWriteFrames(Decimator_t* dec)
+{
+  for (int first = 0; first < dec->num_out; first += kMaxBucketsPerFrame)
+  {
+    int num_buckets = dec->num_out - first < kMaxBucketsPerFrame ? dec->num_out - first : kMaxBucketsPerFrame;
+    char frame[PIPE_BUF];
+    PlotFrameHeader_t header = {
+        .magic = PLOT_FRAME_MAGIC,
+        .frame = dec->frame++,
+        .t_first = dec->out_t_first + first * dec->bucket_s,
+        .bucket_s = dec->bucket_s,
+        .num_buckets = num_buckets,
+        .num_channels = PLOT_CHANNELS,
+        .lttb = dec->lttb,
+    };
+    size_t payload = sizeof(*dec->out) * num_buckets;
+    memcpy(frame, &header, sizeof(header));
+    memcpy(frame + sizeof(header), &dec->out[first], payload);
+
+    ssize_t written = write(dec->fd, frame, sizeof(header) + payload);
+    if (written < 0)
+      dec->frames_dropped++;
+    else
+      dec->bytes_out += written;
+  }
+  dec->num_out = 0;
+}
+
+static void DecimatorEmit(Decimator_t* dec, double t, const int16_t pairs[PLOT_CHANNELS][2])
+{
+  if (dec->num_out == 0)
+    dec->out_t_first = t;
+  memcpy(dec->out[dec->num_out++], pairs, sizeof(*dec->out));
+  if (dec->num_out == dec->out_capacity)
+    DecimatorWriteFrames(dec);
+}
+
+// Pick the point of the pending bucket that makes the largest triangle with the previously
+// chosen point and the average of the bucket just completed. x is in samples from the pending bucket start.
+static void DecimatorLttbSelect(Decimator_t* dec)
+{
+  const int n = dec->samples_per_bucket;
+  int16_t pairs[PLOT_CHANNELS][2];
+  for (int c = 0; c < PLOT_CHANNELS; c++)
+  {
+    float next_avg = 0;
+    for (int j = 0; j < n; j++)
+      next_avg += dec->current[j][c];
+    next_avg /= n;
+    const float next_x = n + 0.5f * (n - 1);
+
+    // The first bucket has no previous point, anchor on its first sample like LTTB keeps the first point.
+    const float ax = dec->have_prev_point ? dec->prev_x[c] : 0;
+    const float ay = dec->have_prev_point ? dec->prev_y[c] : dec->pending[0][c];
+    int best = 0;
+    float best_area = -1;
+    for (int j = 0; j < n; j++)
+    {
+      float area = fabsf((ax - next_x) * (dec->pending[j][c] - ay) - (ax - j) * (next_avg - ay));
+      if (area > best_area)
+      {
+        best_area = area;
+        best = j;
+      }
+    }
+    pairs[c][0] = dec->pending[best][c];
+    pairs[c][1] = best;
+    // Next bucket starts n samples later.
+    dec->prev_x[c] = best - n;
+    dec->prev_y[c] = dec->pending[best][c];
+  }
+  dec->have_prev_point = true;
+  DecimatorEmit(dec, dec->pending_t, pairs);
+}
+
+// Close the bucket and send the frame if the samples just added completed them.
+static void DecimatorAdvance(Decimator_t* dec)
+{
+  if (dec->bucket_fill == dec->samples_per_bucket)
+  {
+    dec->bucket_fill = 0;
+    if (dec->lttb)
+    {
+      // LTTB output lags one bucket behind.
+      if (dec->have_pending)
+        DecimatorLttbSelect(dec);
+      int16_t(*swap)[PLOT_CHANNELS] = dec->pending;
+      dec->pending = dec->current;
+      dec->current = swap;
+      dec->pending_t = dec->bucket_t;
+      dec->have_pending = true;
+    }
+    else
+    {
+      int16_t pairs[PLOT_CHANNELS][2];
+      for (int c = 0; c < PLOT_CHANNELS; c++)
+      {
+        pairs[c][0] = dec->min[c];
+        pairs[c][1] = dec->max[c];
+      }
+      DecimatorEmit(dec, dec->bucket_t, pairs);
+    }
+  }
+
+  // Display refresh.
+  if (dec->since_frame == dec->samples_per_frame)
+  {
+    dec->since_frame = 0;
+    if (dec->num_out > 0)
+      DecimatorWriteFrames(dec);
+  }
+}
+
+void DecimatorPush(Decimator_t* dec, const ImuSample_t* sample)
+{
+  if (dec->fd < 0)
+    return;
+  const int16_t values[PLOT_CHANNELS] = {sample->ax, sample->ay, sample->az, sample->gx, sample->gy, sample->gz};
+  dec->samples_in++;
+
+  if (dec->bucket_fill == 0)
+    dec->bucket_t = sample->t;
+  if (dec->lttb)
+  {
+    memcpy(dec->current[dec->bucket_fill], values, sizeof(values));
+  }
+  else if (dec->bucket_fill == 0)
+  {
+    memcpy(dec->min, values, sizeof(values));
+    memcpy(dec->max, values, sizeof(values));
+  }
+  else
+  {
+    for (int c = 0; c < PLOT_CHANNELS; c++)
+    {
+      dec->min[c] = values[c] < dec->min[c] ? values[c] : dec->min[c];
+      dec->max[c] = values[c] > dec->max[c] ? values[c] : dec->max[c];
+    }
+  }
+
+  dec->bucket_fill++;
+  dec->since_frame++;
+  DecimatorAdvance(dec);
+}
+
+void DecimatorPushBlock(Decimator_t* dec, const ImuBlock_t* block)
+{
+  if (dec->fd < 0)
+    return;
+  if (dec->lttb)
+  {
+    for (int i = 0; i < block->num_samples; i++)
+    {
+      const ImuSample_t sample = ImuBlockGetSample(block, i);
+      DecimatorPush(dec, &sample);
+    }
+    return;
+  }
+
+  // Min/max over runs that end at a bucket or frame boundary, each a contiguous slice per channel.
+  for (int i = 0; i < block->num_samples;)
+  {
+    int run = block->num_samples - i;
+    if (run > dec->samples_per_bucket - dec->bucket_fill)
+      run = dec->samples_per_bucket - dec->bucket_fill;
+    if (run > dec->samples_per_frame - dec->since_frame)
+      run = dec->samples_per_frame - dec->since_frame;
+
+    if (dec->bucket_fill == 0)
+    {
+      dec->bucket_t = block->t_ns[i] * 1e-9;
+      for (int c = 0; c < PLOT_CHANNELS; c++)
+        dec->min[c] = dec->max[c] = block->ch[c][i];
+    }
+    for (int c = 0; c < PLOT_CHANNELS; c++)
+    {
+      const int16_t* x = &block->ch[c][i];
+      int16_t lo = dec->min[c], hi = dec->max[c];
+      for (int j = 0; j < run; j++)
+      {
+        lo = x[j] < lo ? x[j] : lo;
+        hi = x[j] > hi ? x[j] : hi;
+      }
+      dec->min[c] = lo;
+      dec->max[c] = hi;
+    }
+
+    dec->samples_in += run;
+    dec->bucket_fill += run;
+    dec->since_frame += run;
+    i += run;
+    DecimatorAdvance(dec);
+  }
+}
+
+void DecimatorClose(Decimator_t* dec)
+{
+  if (dec->fd >= 0)
+    close(dec->fd);
+  free(dec->out);
+  free(dec->current);
+  free(dec->pending);
+  memset(dec, 0, sizeof(*dec));
+  dec->fd = -1;
+}
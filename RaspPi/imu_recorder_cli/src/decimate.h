@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "imu.h"
+#include "imu_block.h"
+
+// Raw channels in every frame: ax, ay, az, gx, gy, gz.
+#define PLOT_CHANNELS 6
+
+// Frame written once per display refresh. Followed by num_buckets * PLOT_CHANNELS pairs of int16,
+// bucket major. Min/max mode: (min, max). LTTB mode: (value, sample offset in the bucket).
+typedef struct {
+  uint32_t magic;       // PLOT_FRAME_MAGIC.
+  uint32_t frame;       // Counter, a jump means frames were dropped because the reader was slow.
+  double t_first;       // Time of the first sample of the first bucket.
+  float bucket_s;       // Bucket duration, one display column.
+  uint16_t num_buckets; // New columns since the previous frame.
+  uint8_t num_channels; // PLOT_CHANNELS.
+  uint8_t lttb;         // 1 if pairs are (value, offset).
+} PlotFrameHeader_t;
+
+#define PLOT_FRAME_MAGIC 0x504C4F54 // "PLOT".
+
+// Streaming decimation of the live signal to one bucket per display column. Min/max keeps every
+// transient visible, LTTB keeps one point per bucket chosen for the shape of the line.
+typedef struct {
+  int fd;
+  bool lttb;
+  int samples_per_bucket;
+  int samples_per_frame;
+  float bucket_s;
+
+  // Bucket being filled.
+  int bucket_fill;
+  double bucket_t;
+  int16_t min[PLOT_CHANNELS], max[PLOT_CHANNELS];
+
+  // LTTB: samples of the bucket being filled and the one before it, which is chosen from
+  // once the average of the newer one is known.
+  int16_t (*current)[PLOT_CHANNELS];
+  int16_t (*pending)[PLOT_CHANNELS];
+  bool have_pending;
+  double pending_t;
+  bool have_prev_point;
+  float prev_x[PLOT_CHANNELS], prev_y[PLOT_CHANNELS]; // Last chosen point, x relative to the pending bucket.
+
+  // Completed buckets waiting for the next frame.
+  int16_t (*out)[PLOT_CHANNELS][2];
+  int num_out, out_capacity;
+  double out_t_first;
+  int since_frame;
+  uint32_t frame;
+
+  uint64_t samples_in, bytes_out, frames_dropped;
+} Decimator_t;
+
+// Returns false if the output can't be opened, the decimator is then inactive.
+// path may be a named pipe, writes never block the recording.
+bool DecimatorInit(Decimator_t* dec, const ImuConfig_t* config, const char* path);
+// Same without opening a file, fd is used as is.
+void DecimatorInitFd(Decimator_t* dec, const ImuConfig_t* config, int fd);
+void DecimatorPush(Decimator_t* dec, const ImuSample_t* sample);
+// Same output as pushing the samples one by one. Min/max works on the channel arrays directly.
+void DecimatorPushBlock(Decimator_t* dec, const ImuBlock_t* block);
+// Close the output and free the buffers.
+void DecimatorClose(Decimator_t* dec);
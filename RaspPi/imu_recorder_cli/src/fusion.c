@@ -0,0 +1,138 @@
+#include "fusion.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "config.h"
+#include "imu.h"
+
+static const float kGravity = 9.80665f;
+static const float kDegToRad = 0.017453292f;
+// Mahony gains, tuned for a hand-held finger where gyro dominates.
+static const float kKp = 1.0f;
+static const float kKi = 0.0f;
+// Velocity and position forget with this time constant so integration drift stays bounded.
+static const float kLeakTimeConstant = 1.0f;
+
+void FusionInit(FusionState_t *state, int num_sensors, const ImuConfig_t *config)
+{
+  memset(state, 0, sizeof(*state));
+  state->num_sensors = num_sensors < FUSION_MAX_SENSORS ? num_sensors : FUSION_MAX_SENSORS;
+  state->dt = 1.0f / config->odr_hz;
+  state->accel_scale = config->accel_fs_g / 32768.0f;
+  state->gyro_scale = config->gyro_fs_dps / 32768.0f * kDegToRad;
+  state->kp = kKp;
+  state->ki = kKi;
+  state->leak = 1.0f - state->dt / kLeakTimeConstant;
+  for (int i = 0; i < FUSION_MAX_SENSORS; i++)
+    state->q0[i] = 1.0f;
+}
+
+// Start from the roll and pitch given by gravity so the filter doesn't have to converge.
+static void FusionAlignToGravity(FusionState_t *state, const float *ax, const float *ay, const float *az)
+{
+  for (int i = 0; i < state->num_sensors; i++)
+  {
+    float roll = atan2f(ay[i], az[i]);
+    float pitch = atan2f(-ax[i], sqrtf(ay[i] * ay[i] + az[i] * az[i]));
+    float cr = cosf(roll * 0.5f), sr = sinf(roll * 0.5f);
+    float cp = cosf(pitch * 0.5f), sp = sinf(pitch * 0.5f);
+    state->q0[i] = cr * cp;
+    state->q1[i] = sr * cp;
+    state->q2[i] = cr * sp;
+    state->q3[i] = -sr * sp;
+  }
+  state->initialized = 1;
+}
+
+void FusionUpdate(FusionState_t *state, const ImuSample_t *samples)
+{
+  const int n = state->num_sensors;
+  float ax[FUSION_MAX_SENSORS], ay[FUSION_MAX_SENSORS], az[FUSION_MAX_SENSORS];
+  float gx[FUSION_MAX_SENSORS], gy[FUSION_MAX_SENSORS], gz[FUSION_MAX_SENSORS];
+
+  // Gather into per-axis lanes in physical units.
+  for (int i = 0; i < n; i++)
+  {
+    ax[i] = samples[i].ax * state->accel_scale;
+    ay[i] = samples[i].ay * state->accel_scale;
+    az[i] = samples[i].az * state->accel_scale;
+    gx[i] = samples[i].gx * state->gyro_scale;
+    gy[i] = samples[i].gy * state->gyro_scale;
+    gz[i] = samples[i].gz * state->gyro_scale;
+  }
+  if (state->initialized == 0)
+    FusionAlignToGravity(state, ax, ay, az);
+
+  const float dt = state->dt, half_dt = 0.5f * dt;
+  const float kp = state->kp, ki_dt = state->ki * dt, leak = state->leak;
+
+  // Branch-free per-lane update so the compiler can vectorize across sensors.
+  for (int i = 0; i < n; i++)
+  {
+    float q0 = state->q0[i], q1 = state->q1[i], q2 = state->q2[i], q3 = state->q3[i];
+
+    // Normalized accel. The epsilon keeps a zero reading (free fall) at zero without a branch.
+    float a_norm_sq = ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i];
+    float a_inv = 1.0f / sqrtf(a_norm_sq + 1e-12f);
+    float nx = ax[i] * a_inv, ny = ay[i] * a_inv, nz = az[i] * a_inv;
+
+    // Gravity direction predicted by the current orientation, in the body frame.
+    float vx = 2.0f * (q1 * q3 - q0 * q2);
+    float vy = 2.0f * (q0 * q1 + q2 * q3);
+    float vz = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+
+    // Error is the cross product of measured and predicted gravity.
+    float ex = ny * vz - nz * vy;
+    float ey = nz * vx - nx * vz;
+    float ez = nx * vy - ny * vx;
+    state->bx[i] += ki_dt * ex;
+    state->by[i] += ki_dt * ey;
+    state->bz[i] += ki_dt * ez;
+    float wx = gx[i] + kp * ex + state->bx[i];
+    float wy = gy[i] + kp * ey + state->by[i];
+    float wz = gz[i] + kp * ez + state->bz[i];
+
+    // Integrate the quaternion rate and renormalize.
+    float r0 = q0 + (-q1 * wx - q2 * wy - q3 * wz) * half_dt;
+    float r1 = q1 + (q0 * wx + q2 * wz - q3 * wy) * half_dt;
+    float r2 = q2 + (q0 * wy - q1 * wz + q3 * wx) * half_dt;
+    float r3 = q3 + (q0 * wz + q1 * wy - q2 * wx) * half_dt;
+    float q_inv = 1.0f / sqrtf(r0 * r0 + r1 * r1 + r2 * r2 + r3 * r3);
+    q0 = r0 * q_inv;
+    q1 = r1 * q_inv;
+    q2 = r2 * q_inv;
+    q3 = r3 * q_inv;
+    state->q0[i] = q0;
+    state->q1[i] = q1;
+    state->q2[i] = q2;
+    state->q3[i] = q3;
+
+    // Rotate accel to the world frame and remove 1g on z.
+    float wax = (1 - 2 * (q2 * q2 + q3 * q3)) * ax[i] + 2 * (q1 * q2 - q0 * q3) * ay[i] + 2 * (q1 * q3 + q0 * q2) * az[i];
+    float way = 2 * (q1 * q2 + q0 * q3) * ax[i] + (1 - 2 * (q1 * q1 + q3 * q3)) * ay[i] + 2 * (q2 * q3 - q0 * q1) * az[i];
+    float waz = 2 * (q1 * q3 - q0 * q2) * ax[i] + 2 * (q2 * q3 + q0 * q1) * ay[i] + (1 - 2 * (q1 * q1 + q2 * q2)) * az[i];
+    state->lx[i] = wax * kGravity;
+    state->ly[i] = way * kGravity;
+    state->lz[i] = (waz - 1.0f) * kGravity;
+
+    // Leaky integration, a first order high-pass on velocity and position.
+    state->vx[i] = leak * (state->vx[i] + state->lx[i] * dt);
+    state->vy[i] = leak * (state->vy[i] + state->ly[i] * dt);
+    state->vz[i] = leak * (state->vz[i] + state->lz[i] * dt);
+    state->px[i] = leak * (state->px[i] + state->vx[i] * dt);
+    state->py[i] = leak * (state->py[i] + state->vy[i] * dt);
+    state->pz[i] = leak * (state->pz[i] + state->vz[i] * dt);
+  }
+}
+
+FusionOutput_t FusionGetOutput(const FusionState_t *state, int sensor)
+{
+  FusionOutput_t out = {
+      .q = {state->q0[sensor], state->q1[sensor], state->q2[sensor], state->q3[sensor]},
+      .lin_acc = {state->lx[sensor], state->ly[sensor], state->lz[sensor]},
+      .vel = {state->vx[sensor], state->vy[sensor], state->vz[sensor]},
+      .pos = {state->px[sensor], state->py[sensor], state->pz[sensor]},
+  };
+  return out;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "config.h"
+#include "imu.h"
+
+// Most sensors fused in lock step. Lanes are laid out so the update loop vectorizes.
+#define FUSION_MAX_SENSORS 8
+
+// Mahony orientation filter plus gravity removal and leaky velocity/position integration.
+// Every array is indexed by sensor, so one update advances all sensors by one sample.
+typedef struct {
+  int num_sensors;
+  int initialized;
+  float dt;          // Sample period in seconds.
+  float accel_scale; // g per LSB.
+  float gyro_scale;  // rad/s per LSB.
+  float kp, ki;      // Mahony proportional and integral gains.
+  float leak;        // Per-sample decay of velocity and position, limits drift.
+
+  float q0[FUSION_MAX_SENSORS], q1[FUSION_MAX_SENSORS], q2[FUSION_MAX_SENSORS], q3[FUSION_MAX_SENSORS];
+  float bx[FUSION_MAX_SENSORS], by[FUSION_MAX_SENSORS], bz[FUSION_MAX_SENSORS]; // Integral feedback.
+  float lx[FUSION_MAX_SENSORS], ly[FUSION_MAX_SENSORS], lz[FUSION_MAX_SENSORS]; // World linear accel, m/s^2.
+  float vx[FUSION_MAX_SENSORS], vy[FUSION_MAX_SENSORS], vz[FUSION_MAX_SENSORS]; // World velocity, m/s.
+  float px[FUSION_MAX_SENSORS], py[FUSION_MAX_SENSORS], pz[FUSION_MAX_SENSORS]; // World position, m.
+} FusionState_t;
+
+// Orientation-independent channels of one sensor after an update.
+typedef struct {
+  float q[4];       // Orientation quaternion w, x, y, z (body to world).
+  float lin_acc[3]; // Gravity-free acceleration in the world frame, m/s^2.
+  float vel[3];     // Drift-limited velocity, m/s.
+  float pos[3];     // Drift-limited position, m.
+} FusionOutput_t;
+
+void FusionInit(FusionState_t* state, int num_sensors, const ImuConfig_t* config);
+// samples[i] is the current sample of sensor i, for i < num_sensors.
+void FusionUpdate(FusionState_t* state, const ImuSample_t* samples);
+FusionOutput_t FusionGetOutput(const FusionState_t* state, int sensor);
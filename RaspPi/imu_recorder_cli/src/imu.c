@@ -1,5 +1,6 @@
 #include "imu.h"
 #include <stdint.h>
+#include "config.h"
 #include "spi.h"
 #include <stdio.h>
 #include <unistd.h>
@@ -74,8 +75,10 @@ Accelerometer ODR selection for UI interface output
 
 // https://download.mikroe.com/documents/datasheets/ICM-42688-P_Datasheet.pdf
 
+ImuReadStats_t gImuReadStats = {0};
+
 // One-time writes to IMU config-type registers. NOT OPTIONAL.
-void ImuInitRegisters(int file_desc)
+void ImuInitRegisters(int file_desc, const ImuConfig_t *config)
 {
   uint8_t spi_out[6], in_buf[6];
 
@@ -111,22 +114,45 @@ void ImuInitRegisters(int file_desc)
   spi_out[1] = 0b10010001;
   spi_transfer(file_desc, spi_out, in_buf, 2);
 
-  // Refer to reference comments above.
-  const int kGyroAccelConfigCode = 0b00000100; // default FS, 4000hz
+  // Refer to reference comments above. Codes were validated when the config was parsed.
+  // One register per transfer, a longer write would go on to 0x51 rather than to GYRO_CONFIG0.
   spi_out[0] = kAccelConfig0;
-  spi_out[1] = kGyroAccelConfigCode;
-  spi_out[2] = kGyroConfig0;
-  spi_out[3] = kGyroAccelConfigCode;
-  spi_transfer(file_desc, spi_out, in_buf, 4);
+  spi_out[1] = (ConfigAccelFsCode(config) << 5) | ConfigOdrCode(config);
+  spi_transfer(file_desc, spi_out, in_buf, 2);
+  spi_out[0] = kGyroConfig0;
+  spi_out[1] = (ConfigGyroFsCode(config) << 5) | ConfigOdrCode(config);
+  spi_transfer(file_desc, spi_out, in_buf, 2);
+
+  // Count FIFO in records, keep big endian data.
+  spi_out[0] = kIntfConfig0;
+  spi_out[1] = 0b01110000;
+  spi_transfer(file_desc, spi_out, in_buf, 2);
+
+  // Absolute timestamp with 1us resolution, so FIFO packets carry a sample counter.
+  spi_out[0] = kTmstConfig;
+  spi_out[1] = 0b00100001;
+  spi_transfer(file_desc, spi_out, in_buf, 2);
+
+  // Put accel, gyro, temperature and timestamp in the FIFO (16 byte packets).
+  spi_out[0] = kFifoConfig1;
+  spi_out[1] = 0b00000111;
+  spi_transfer(file_desc, spi_out, in_buf, 2);
+
+  // FIFO stream mode.
+  spi_out[0] = kFifoConfig;
+  spi_out[1] = 0b01000000;
+  spi_transfer(file_desc, spi_out, in_buf, 2);
 
   // Bank 1.
   spi_out[0] = kRegBankSel;
   spi_out[1] = 0b00000001; // Change from bank 0 to bank 1.
-  spi_out[2] = kIntfConfig5;
-  spi_out[3] = 0b00000000; // Sets pin 9 function to Default (INT2).
-  spi_out[4] = kRegBankSel;
-  spi_out[5] = 0b00000000; // Change from bank 1 to bank 0.
-  spi_transfer(file_desc, spi_out, in_buf, 6);
+  spi_transfer(file_desc, spi_out, in_buf, 2);
+  spi_out[0] = kIntfConfig5;
+  spi_out[1] = 0b00000000; // Sets pin 9 function to Default (INT2).
+  spi_transfer(file_desc, spi_out, in_buf, 2);
+  spi_out[0] = kRegBankSel;
+  spi_out[1] = 0b00000000; // Change from bank 1 to bank 0.
+  spi_transfer(file_desc, spi_out, in_buf, 2);
 
   // Reading test.
   const int kWhoAmI = 0x75;
@@ -136,3 +162,40 @@ void ImuInitRegisters(int file_desc)
   if (in_buf[1] != 0x47)
     printf("Warning: WHO_AM_I register of IMU device did not return expected value of 0x47. Value: 0x%x\n", in_buf[1]);
 }
+
+// Append validity counters as comment lines so csv readers skip them.
+void ImuWriteStats(FILE *file, const ImuReadStats_t *stats)
+{
+  fprintf(file,
+          "# edges=%llu\n"
+          "# samples=%llu\n"
+          "# empty_reads=%llu\n"
+          "# duplicates=%llu\n"
+          "# invalid=%llu\n"
+          "# gaps=%llu\n"
+          "# missing_samples=%llu\n"
+          "# fifo_overflows=%llu\n"
+          "# max_backlog=%d\n",
+          (unsigned long long)stats->edges,
+          (unsigned long long)stats->samples,
+          (unsigned long long)stats->empty,
+          (unsigned long long)stats->duplicates,
+          (unsigned long long)stats->invalid,
+          (unsigned long long)stats->gaps,
+          (unsigned long long)stats->missing,
+          (unsigned long long)stats->overflows,
+          stats->max_backlog);
+}
+
+ImuReadStats_t ImuStatsSince(const ImuReadStats_t *now, const ImuReadStats_t *start)
+{
+  return (ImuReadStats_t){now->edges - start->edges,
+                          now->samples - start->samples,
+                          now->empty - start->empty,
+                          now->duplicates - start->duplicates,
+                          now->invalid - start->invalid,
+                          now->gaps - start->gaps,
+                          now->missing - start->missing,
+                          now->overflows - start->overflows,
+                          now->max_backlog};
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdio.h>
+
+#include "config.h"
 
 enum ImuRegs {
   // IMU registers
@@ -27,8 +30,37 @@ enum ImuRegs {
   kAccelConfig0 = 0x50,
   kGyroConfig0 = 0x4f,
   kDeviceConfig = 0x11,
+  kIntStatus = 0x2D,
+  kFifoCountH = 0x2E,
+  kFifoCountL = 0x2F,
+  kFifoData = 0x30,
+  kFifoConfig = 0x16,
+  kFifoConfig1 = 0x5F,
+  kIntfConfig0 = 0x4C,
+  kSignalPathReset = 0x4B,
+  kTmstConfig = 0x54,
+};
+
+enum ImuFifo {
+  // FIFO packet 3: header, accel xyz, gyro xyz, temperature, 16 bit timestamp.
+  kFifoPacketSize = 16,
+  // Read burst starts at INT_STATUS and runs through FIFO_COUNTH/L into FIFO_DATA.
+  kFifoBurstOverhead = 4,
+  // Most packets popped in one burst when catching up on a backlog.
+  kFifoMaxBurstPackets = 8,
+  // Header with accel, gyro and ODR timestamp present, ignoring the ODR change bits.
+  kFifoHeaderMask = 0xFC,
+  kFifoHeaderExpected = 0x68,
+  kFifoHeaderEmpty = 0x80,
+  // Value the IMU reports for invalid sensor data.
+  kFifoInvalidSample = -32768,
+  // INT_STATUS bit, set when the FIFO filled since the last read.
+  kIntStatusFifoFull = 0x02,
 };
 
+// Seconds per sensor timestamp tick (TMST_RES = 0).
+#define IMU_TMST_TICK_S 1e-6
+
 typedef struct {
   double t;
   int16_t ax;
@@ -37,6 +69,25 @@ typedef struct {
   int16_t gx;
   int16_t gy;
   int16_t gz;
+  uint16_t tmst; // Sensor timestamp in IMU_TMST_TICK_S ticks, wraps. Fits in padding.
 } ImuSample_t;
 
-void ImuInitRegisters(int file_desc);
+// Validity counters for the current recording, see SpiImuReadParse().
+typedef struct {
+  uint64_t edges;      // Read bursts performed.
+  uint64_t samples;    // Valid samples returned.
+  uint64_t empty;      // Bursts that found no new data (spurious or stale edge).
+  uint64_t duplicates; // Samples with the same timestamp as the previous one.
+  uint64_t invalid;    // Bad FIFO header or invalid-data marker, FIFO is flushed.
+  uint64_t gaps;       // Timestamp jumps larger than 1.5 sample periods.
+  uint64_t missing;    // Samples estimated lost in those gaps.
+  uint64_t overflows;  // Bursts that saw the FIFO full flag.
+  int max_backlog;     // Most packets left in the FIFO after a burst.
+} ImuReadStats_t;
+
+extern ImuReadStats_t gImuReadStats;
+
+void ImuInitRegisters(int file_desc, const ImuConfig_t* config);
+void ImuWriteStats(FILE* file, const ImuReadStats_t* stats);
+// Counters accumulated between two snapshots. max_backlog is not a counter, the newer value is kept.
+ImuReadStats_t ImuStatsSince(const ImuReadStats_t* now, const ImuReadStats_t* start);
@@ -0,0 +1,155 @@
+#include "imu_block.h"
+
+#include <stdint.h>
+
+#include "imu.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define IMU_BLOCK_X86
+#endif
+
+// Lanes of the byte-swapped packet: the six channels, the timestamp and the header, 8 int16.
+enum { kPacketLanes = 8 };
+
+// Shuffle that turns one packet into its 8 lanes in native order. Each big endian field at
+// offset o becomes bytes (o + 1, o). The header is zero extended, indices >= 0x80 give 0.
+static const uint8_t kSwapShuffle[16] = {2, 1, 4, 3, 6, 5, 8, 7, 10, 9, 12, 11, 15, 14, 0, 0x80};
+
+// Packets first to num_packets - 1, one field at a time.
+static void ParsePackets(ImuBlock_t* block, const uint8_t* packets, int first, int num_packets)
+{
+  for (int i = first; i < num_packets; i++)
+  {
+    const uint8_t* packet = &packets[i * kFifoPacketSize];
+    for (int c = 0; c < IMU_BLOCK_CHANNELS; c++)
+      block->ch[c][i] = (packet[1 + 2 * c] << 8) | packet[2 + 2 * c];
+    block->tmst[i] = (packet[14] << 8) | packet[15];
+    block->header[i] = packet[0];
+  }
+  block->num_samples = num_packets;
+}
+
+void ImuBlockParseFifoScalar(ImuBlock_t* block, const uint8_t* packets, int num_packets)
+{
+  ParsePackets(block, packets, 0, num_packets);
+}
+
+// Eight packets at a time: one shuffle per packet gives a row of lanes, an 8x8 int16 transpose
+// turns the rows into eight samples of each lane.
+#if defined(__aarch64__)
+static int ParseFifoSimd(ImuBlock_t* block, const uint8_t* packets, int num_packets)
+{
+  const uint8x16_t shuffle = vld1q_u8(kSwapShuffle);
+  int i = 0;
+  for (; i + 8 <= num_packets; i += 8)
+  {
+    uint16x8_t r[8];
+    for (int k = 0; k < 8; k++)
+      r[k] = vreinterpretq_u16_u8(vqtbl1q_u8(vld1q_u8(&packets[(i + k) * kFifoPacketSize]), shuffle));
+    uint32x4_t t[8], u[8];
+    for (int k = 0; k < 4; k++)
+    {
+      t[2 * k] = vreinterpretq_u32_u16(vzip1q_u16(r[2 * k], r[2 * k + 1]));
+      t[2 * k + 1] = vreinterpretq_u32_u16(vzip2q_u16(r[2 * k], r[2 * k + 1]));
+    }
+    for (int k = 0; k < 2; k++)
+    {
+      u[4 * k] = vzip1q_u32(t[4 * k], t[4 * k + 2]);
+      u[4 * k + 1] = vzip2q_u32(t[4 * k], t[4 * k + 2]);
+      u[4 * k + 2] = vzip1q_u32(t[4 * k + 1], t[4 * k + 3]);
+      u[4 * k + 3] = vzip2q_u32(t[4 * k + 1], t[4 * k + 3]);
+    }
+    uint16_t* const dst[kPacketLanes] = {(uint16_t*)&block->ch[0][i], (uint16_t*)&block->ch[1][i],
+                                         (uint16_t*)&block->ch[2][i], (uint16_t*)&block->ch[3][i],
+                                         (uint16_t*)&block->ch[4][i], (uint16_t*)&block->ch[5][i],
+                                         &block->tmst[i], &block->header[i]};
+    for (int k = 0; k < 4; k++)
+    {
+      const uint64x2_t lo = vreinterpretq_u64_u32(u[k]), hi = vreinterpretq_u64_u32(u[k + 4]);
+      vst1q_u16(dst[2 * k], vreinterpretq_u16_u64(vzip1q_u64(lo, hi)));
+      vst1q_u16(dst[2 * k + 1], vreinterpretq_u16_u64(vzip2q_u64(lo, hi)));
+    }
+  }
+  return i;
+}
+#elif defined(IMU_BLOCK_X86)
+__attribute__((target("ssse3"))) static int ParseFifoSimd(ImuBlock_t* block, const uint8_t* packets,
+                                                          int num_packets)
+{
+  const __m128i shuffle = _mm_loadu_si128((const __m128i*)kSwapShuffle);
+  int i = 0;
+  for (; i + 8 <= num_packets; i += 8)
+  {
+    __m128i r[8], t[8], u[8];
+    for (int k = 0; k < 8; k++)
+      r[k] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&packets[(i + k) * kFifoPacketSize]), shuffle);
+    for (int k = 0; k < 4; k++)
+    {
+      t[2 * k] = _mm_unpacklo_epi16(r[2 * k], r[2 * k + 1]);
+      t[2 * k + 1] = _mm_unpackhi_epi16(r[2 * k], r[2 * k + 1]);
+    }
+    for (int k = 0; k < 2; k++)
+    {
+      u[4 * k] = _mm_unpacklo_epi32(t[4 * k], t[4 * k + 2]);
+      u[4 * k + 1] = _mm_unpackhi_epi32(t[4 * k], t[4 * k + 2]);
+      u[4 * k + 2] = _mm_unpacklo_epi32(t[4 * k + 1], t[4 * k + 3]);
+      u[4 * k + 3] = _mm_unpackhi_epi32(t[4 * k + 1], t[4 * k + 3]);
+    }
+    void* const dst[kPacketLanes] = {&block->ch[0][i], &block->ch[1][i], &block->ch[2][i], &block->ch[3][i],
+                                     &block->ch[4][i], &block->ch[5][i], &block->tmst[i], &block->header[i]};
+    for (int k = 0; k < 4; k++)
+    {
+      _mm_storeu_si128(dst[2 * k], _mm_unpacklo_epi64(u[k], u[k + 4]));
+      _mm_storeu_si128(dst[2 * k + 1], _mm_unpackhi_epi64(u[k], u[k + 4]));
+    }
+  }
+  return i;
+}
+#endif
+
+void ImuBlockParseFifo(ImuBlock_t* block, const uint8_t* packets, int num_packets)
+{
+  int done = 0;
+#if defined(__aarch64__)
+  done = ParseFifoSimd(block, packets, num_packets);
+#elif defined(IMU_BLOCK_X86)
+  if (num_packets >= 8 && __builtin_cpu_supports("ssse3"))
+    done = ParseFifoSimd(block, packets, num_packets);
+#endif
+  // Leftover packets, and everything on targets without a vector path.
+  ParsePackets(block, packets, done, num_packets);
+}
+
+void ImuBlockMoveSample(ImuBlock_t* block, int to, int from)
+{
+  for (int c = 0; c < IMU_BLOCK_CHANNELS; c++)
+    block->ch[c][to] = block->ch[c][from];
+  block->t_ns[to] = block->t_ns[from];
+  block->tmst[to] = block->tmst[from];
+  block->header[to] = block->header[from];
+}
+
+void ImuBlockSetTimes(ImuBlock_t* block, int64_t edge_ns)
+{
+  if (block->num_samples == 0)
+    return;
+  const uint16_t newest = block->tmst[block->num_samples - 1];
+  const int64_t ns_per_tick = (int64_t)(IMU_TMST_TICK_S * 1e9 + 0.5);
+  for (int i = 0; i < block->num_samples; i++)
+    block->t_ns[i] = edge_ns - (uint16_t)(newest - block->tmst[i]) * ns_per_tick;
+}
+
+ImuSample_t ImuBlockGetSample(const ImuBlock_t* block, int index)
+{
+  return (ImuSample_t){block->t_ns[index] * 1e-9,
+                       block->ch[0][index],
+                       block->ch[1][index],
+                       block->ch[2][index],
+                       block->ch[3][index],
+                       block->ch[4][index],
+                       block->ch[5][index],
+                       block->tmst[index]};
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "imu.h"
+
+// Raw channels of a block, ax, ay, az, gx, gy, gz in that order.
+#define IMU_BLOCK_CHANNELS 6
+// A full 2 KB FIFO of 16 byte packets, the most one burst can return.
+#define IMU_BLOCK_CAPACITY 128
+// Channel arrays start on this boundary so consumers can use aligned vector loads.
+#define IMU_BLOCK_ALIGN 32
+
+// Samples of one burst stored by channel rather than by sample, so formatting, min/max and
+// feature code read contiguous int16 runs. Passed between stages by pointer, never copied.
+typedef struct {
+  int num_samples;
+  _Alignas(IMU_BLOCK_ALIGN) int16_t ch[IMU_BLOCK_CHANNELS][IMU_BLOCK_CAPACITY];
+  _Alignas(IMU_BLOCK_ALIGN) int64_t t_ns[IMU_BLOCK_CAPACITY]; // Since the recording start.
+  uint16_t tmst[IMU_BLOCK_CAPACITY];   // Sensor timestamp in IMU_TMST_TICK_S ticks, wraps.
+  uint16_t header[IMU_BLOCK_CAPACITY]; // FIFO header byte, only meaningful until validated.
+} ImuBlock_t;
+
+// Byte-swap num_packets FIFO packets (kFifoPacketSize bytes each, any alignment) into the block,
+// replacing its contents. Uses NEON or SSSE3 when available. t_ns is left for the caller.
+void ImuBlockParseFifo(ImuBlock_t* block, const uint8_t* packets, int num_packets);
+// Plain C version of the same, for comparison.
+void ImuBlockParseFifoScalar(ImuBlock_t* block, const uint8_t* packets, int num_packets);
+// Copy sample from to index to, used to drop rejected samples in place.
+void ImuBlockMoveSample(ImuBlock_t* block, int to, int from);
+// The newest sample is at edge_ns, older ones are placed back from it by sensor timestamp.
+void ImuBlockSetTimes(ImuBlock_t* block, int64_t edge_ns);
+// One sample in the per-sample layout, for stages that work a sample at a time.
+ImuSample_t ImuBlockGetSample(const ImuBlock_t* block, int index);
@@ -15,6 +15,9 @@ inline double TimespecToDouble(timespec ts) {
 inline double TimespecDiff(timespec ts1, timespec ts2) {
   return fabs((ts2.tv_sec - ts1.tv_sec) + (ts2.tv_nsec - ts1.tv_nsec) / 1e9);
 }
+int64_t TimespecDiffNs(timespec from, timespec to) {
+  return (int64_t)(to.tv_sec - from.tv_sec) * 1000000000 + (to.tv_nsec - from.tv_nsec);
+}
 inline void GetMonotonic(timespec* ts_ptr) {
   clock_gettime(CLOCK_MONOTONIC, ts_ptr);
 }
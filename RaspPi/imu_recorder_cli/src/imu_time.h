@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdint.h>
 #include <time.h>
 
 typedef struct timespec timespec; // Alias.
@@ -19,6 +20,8 @@ extern ImuTimespecs gTimes;
 extern ImuTimespecs gPrevTimes;
 
 double TimespecDiff(timespec ts1, timespec ts2);
+// Signed, to - from in nanoseconds.
+int64_t TimespecDiffNs(timespec from, timespec to);
 void GetMonotonic(timespec* ts_ptr);
 void PrintDebugTimes(double cutoff_ms);
 void UpdatePrevTimespecs();
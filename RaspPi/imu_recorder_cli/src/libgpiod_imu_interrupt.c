@@ -136,4 +136,18 @@ bool GpioGetEvent()
   // Pop detected event and return true.
   gpiod_edge_event_buffer_get_event(event_buffer, 0);
   return true;
+}
+
+void GpioDrainEvents()
+{
+  while (gpiod_line_request_wait_edge_events(request, 0) > 0)
+  {
+    if (gpiod_line_request_read_edge_events(request, event_buffer, event_buf_size) <= 0)
+      return;
+  }
+}
+
+int GpioGetFd()
+{
+  return gpiod_line_request_get_fd(request);
 }
\ No newline at end of file
@@ -4,4 +4,10 @@
 int GpioSetup(const unsigned int line_offset);
 
 // Check if an event occurred.
-bool GpioGetEvent();
\ No newline at end of file
+bool GpioGetEvent();
+
+// Discard queued edges without warnings, e.g. those left from before a recording started.
+void GpioDrainEvents();
+
+// File descriptor that polls readable when an edge is pending.
+int GpioGetFd();
\ No newline at end of file
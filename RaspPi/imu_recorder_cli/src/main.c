@@ -6,23 +6,37 @@
 #include <assert.h>
 
 #include "cli.h"
+#include "config.h"
 #include "csv.h"
-#include "imu.h"
-#include "imu_time.h"
+#include "daemon.h"
 #include "libgpiod_imu_interrupt.h"
 #include "priority_manager.h"
+#include "recorder.h"
+#include "selfcheck.h"
 #include "spi.h"
 
 const int kImuIntPin = 25; // Adjust as needed.
 
-int main(void)
+int main(int argc, char **argv)
 {
-  SetMaxPriority();                  // Makes program run with less stalling.
-  SigIntHandlerSetup();              // Handle Ctrl+C terminal interrupt.
-  InitSpiDevice();                   // Init spi device.
-  GpioSetup(kImuIntPin);             // Init IMU interrupt pin.
+  ConfigParseArgs(&gImuConfig, argc, argv); // Config file and command line settings.
+  SetMaxPriority();                         // Makes program run with less stalling.
+  SigIntHandlerSetup();                     // Handle Ctrl+C terminal interrupt.
+  InitSpiDevice(&gImuConfig);               // Init spi device.
+  GpioSetup(kImuIntPin);                    // Init IMU interrupt pin.
+
+  // Refuse rates the pipeline can't keep up with unless forced.
+  if (SelfCheckPipeline(&gImuConfig) == false && gImuConfig.force == false)
+  {
+    printf("Use --force to record anyway.\n");
+    return 1;
+  }
   printf("Program Initialized\n\n"); // Status message.
 
+  // Commands come from a Unix socket instead of the terminal.
+  if (gImuConfig.daemon_path[0] != '\0')
+    return DaemonRun(&gImuConfig, gImuConfig.daemon_path);
+
   // Record loop.
   while (true)
   {
@@ -37,15 +51,10 @@ int main(void)
     while (stdin_has_data_poll() == true)
       getchar();
 
-    // Create/open file.
-    gImuCsvFd = OpenNewCsv();
-
-    // Print csv headers.
-    fprintf(gImuCsvFd, "Time, ax, ay, az, gx, gy, gz\n");
-
-    // Get the recording monotonic time at start.
-    GetMonotonic(&gTimes.start_time);
-    gPrevTimes.curr_time = gTimes.start_time;
+    // Open the session's files and start from an empty IMU FIFO, dropping edges queued since the last one.
+    static Recorder_t recorder;
+    GpioDrainEvents();
+    RecorderStart(&recorder, &gImuConfig, NULL);
 
     // IMU loop.
     printf("Recording...\n");
@@ -54,9 +63,7 @@ int main(void)
       // Check stdin buffer for recording stop command.
       if (stdin_has_data_poll())
       {
-        // Close csv file.
-        fclose(gImuCsvFd);
-        gImuCsvFd = NULL;
+        RecorderStop(&recorder);
         // Flush stdin.
         while (stdin_has_data_poll() == true)
           getchar();
@@ -69,52 +76,8 @@ int main(void)
         continue;
       }
 
-      // Counter [0, 999].
-      static int count = 999;
-      if (++count == 1000)
-        count = 0;
-
-      // Get current time.
-      GetMonotonic(&gTimes.curr_time);
-
-      // Perform the SPI transfer.
-      ImuSample_t imu_data = SpiImuReadParse();
-      // Add time data.
-      imu_data.t = TimespecDiff(gTimes.curr_time, gTimes.start_time);
-
-      // Post-SPI time.
-      GetMonotonic(&gTimes.spi_time);
-      // Debug post-parse time.
-      GetMonotonic(&gTimes.parse_time);
-
-      // Print sample data.
-      static double last_print_time = 0;
-      if (imu_data.t > last_print_time + 0.5)
-      {
-        last_print_time = imu_data.t;
-        printf("%f, %d, %d, %d, %d, %d, %d\n",
-               imu_data.t,
-               imu_data.ax, imu_data.ay, imu_data.az,
-               imu_data.gx, imu_data.gy, imu_data.gz);
-      }
-
-      // Log received data.
-      int chars_printed = fprintf(gImuCsvFd, "%f, %d, %d, %d, %d, %d, %d\n",
-                                  imu_data.t,
-                                  imu_data.ax, imu_data.ay, imu_data.az,
-                                  imu_data.gx, imu_data.gy, imu_data.gz);
-      assert(chars_printed > 1);
-
-      // Post-log time.
-      GetMonotonic(&gTimes.log_time);
-
-      // Post-stdin time.
-      GetMonotonic(&gTimes.stdin_time);
-
-      // Print debug info.
-      PrintDebugTimes(1.5); // 1.5ms is the lower cutoff to print debug info.
-      // Update prev timespecs.
-      UpdatePrevTimespecs();
+      // Read, timestamp and log the new samples.
+      RecorderService(&recorder);
     }
     printf("RECORDING ENDED\n\n");
   }
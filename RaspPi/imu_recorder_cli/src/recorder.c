@@ -0,0 +1,149 @@
+#include "recorder.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "config.h"
+#include "csv.h"
+#include "decimate.h"
+#include "fusion.h"
+#include "imu.h"
+#include "imu_block.h"
+#include "imu_time.h"
+#include "spi.h"
+#include "trigger.h"
+
+void RecorderStart(Recorder_t *rec, const ImuConfig_t *config, const timespec *command_time)
+{
+  rec->config = *config;
+  CsvNewSessionName(rec->session_name, sizeof(rec->session_name), config->label);
+
+  // Create/open file, in trigger mode files are opened per contact episode.
+  if (rec->config.trigger)
+  {
+    TriggerInit(&rec->trigger, &rec->config, rec->session_name);
+  }
+  else
+  {
+    gImuCsvFd = OpenCsv(rec->session_name);
+    OpenWav(rec->session_name, &rec->config);
+    // Print recording settings and csv headers.
+    ConfigWriteHeader(gImuCsvFd, &rec->config);
+    CsvWriteColumnNames(gImuCsvFd, &rec->config);
+  }
+
+  // Fresh orientation estimate per recording.
+  FusionInit(&rec->fusion, 1, &rec->config);
+
+  // Live plot output, reopened per recording so a GUI can attach between recordings.
+  rec->decimator.fd = -1;
+  if (rec->config.plot_path[0] != '\0')
+    DecimatorInit(&rec->decimator, &rec->config, rec->config.plot_path);
+
+  // Start from an empty IMU FIFO and get the recording monotonic time at start.
+  SpiImuStartStream();
+  GetMonotonic(&gTimes.start_time);
+  gPrevTimes.curr_time = gTimes.start_time;
+
+  rec->command_time = command_time != NULL ? *command_time : gTimes.start_time;
+  rec->start_latency_s = -1;
+  rec->num_samples = 0;
+  rec->last_print_time = 0;
+  rec->recording = true;
+}
+
+int RecorderService(Recorder_t *rec)
+{
+  // Get current time.
+  GetMonotonic(&gTimes.curr_time);
+
+  // Perform the SPI transfer. Empty, duplicate and invalid reads are dropped here.
+  ImuBlock_t *block = &rec->block;
+  int num_samples = SpiImuReadBlock(block, kFifoMaxBurstPackets);
+
+  // Post-SPI time.
+  GetMonotonic(&gTimes.spi_time);
+
+  // Add time data. The newest sample gets the interrupt time, older ones are placed by sensor timestamp.
+  ImuBlockSetTimes(block, TimespecDiffNs(gTimes.start_time, gTimes.curr_time));
+
+  // Debug post-parse time.
+  GetMonotonic(&gTimes.parse_time);
+
+  // Print sample data.
+  double edge_t = TimespecDiff(gTimes.curr_time, gTimes.start_time);
+  if (num_samples > 0 && edge_t > rec->last_print_time + 0.5)
+  {
+    ImuSample_t imu_data = ImuBlockGetSample(block, num_samples - 1);
+    rec->last_print_time = imu_data.t;
+    printf("%f, %d, %d, %d, %d, %d, %d\n",
+           imu_data.t,
+           imu_data.ax, imu_data.ay, imu_data.az,
+           imu_data.gx, imu_data.gy, imu_data.gz);
+  }
+
+  // Log received data, with orientation-independent channels if enabled. The plot and file
+  // writers take the whole block, fusion and the trigger detector go sample by sample.
+  DecimatorPushBlock(&rec->decimator, block);
+  FusionOutput_t fusion_out[kFifoMaxBurstPackets];
+  if (rec->config.fusion || rec->config.trigger)
+  {
+    for (int i = 0; i < num_samples; i++)
+    {
+      const ImuSample_t sample = ImuBlockGetSample(block, i);
+      if (rec->config.fusion)
+      {
+        FusionUpdate(&rec->fusion, &sample);
+        fusion_out[i] = FusionGetOutput(&rec->fusion, 0);
+      }
+      if (rec->config.trigger)
+        TriggerPush(&rec->trigger, &sample, rec->config.fusion ? &fusion_out[i] : NULL);
+    }
+  }
+  if (rec->config.trigger == false && num_samples > 0)
+  {
+    int chars_printed = CsvWriteBlock(gImuCsvFd, block, rec->config.fusion ? fusion_out : NULL);
+    assert(chars_printed > 1);
+    WriteWavBlock(block);
+  }
+  rec->num_samples += num_samples;
+
+  // Post-log time.
+  GetMonotonic(&gTimes.log_time);
+  if (rec->start_latency_s < 0 && num_samples > 0)
+  {
+    rec->start_latency_s = TimespecDiff(rec->command_time, gTimes.log_time);
+    printf("First sample logged %.3f ms after the start command\n", rec->start_latency_s * 1e3);
+  }
+
+  // Post-stdin time.
+  GetMonotonic(&gTimes.stdin_time);
+
+  // Print debug info.
+  PrintDebugTimes(1.5); // 1.5ms is the lower cutoff to print debug info.
+  // Update prev timespecs.
+  UpdatePrevTimespecs();
+  return num_samples;
+}
+
+void RecorderStop(Recorder_t *rec)
+{
+  // Close csv file, this also appends the validity counters.
+  if (rec->config.trigger)
+  {
+    TriggerFinish(&rec->trigger);
+  }
+  else
+  {
+    fprintf(gImuCsvFd, "# start_latency_ms=%f\n", rec->start_latency_s * 1e3);
+    CloseCsv();
+  }
+  ImuWriteStats(stdout, &gImuReadStats);
+  if (rec->decimator.fd >= 0)
+    printf("plot: %llu bytes in %u frames, %llu dropped\n",
+           (unsigned long long)rec->decimator.bytes_out, rec->decimator.frame,
+           (unsigned long long)rec->decimator.frames_dropped);
+  DecimatorClose(&rec->decimator);
+  rec->recording = false;
+}
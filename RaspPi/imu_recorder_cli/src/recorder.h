@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "decimate.h"
+#include "fusion.h"
+#include "imu_block.h"
+#include "imu_time.h"
+#include "trigger.h"
+
+// One recording session: files, fusion, trigger and live plot state. Shared by the
+// interactive loop in main.c and the daemon.
+typedef struct {
+  ImuConfig_t config; // Snapshot at start, the next session's settings can change meanwhile.
+  char session_name[64];
+  bool recording;
+  Trigger_t trigger;
+  FusionState_t fusion;
+  Decimator_t decimator;
+  ImuBlock_t block; // Samples of the last burst.
+  timespec command_time;  // When the start was requested.
+  double start_latency_s; // Start request to first logged sample, negative until then.
+  uint64_t num_samples;
+  double last_print_time;
+} Recorder_t;
+
+// Open the session's files and start from an empty IMU FIFO. command_time may be NULL.
+void RecorderStart(Recorder_t* rec, const ImuConfig_t* config, const timespec* command_time);
+// Read and log the samples behind one interrupt edge. Returns the number logged.
+int RecorderService(Recorder_t* rec);
+// Close the files and print the validity counters.
+void RecorderStop(Recorder_t* rec);
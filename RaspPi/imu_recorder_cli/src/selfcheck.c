@@ -0,0 +1,91 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "selfcheck.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "config.h"
+#include "csv.h"
+#include "fusion.h"
+#include "imu.h"
+#include "imu_block.h"
+#include "imu_time.h"
+#include "spi.h"
+
+// Bytes clocked per sample: status, FIFO count and one FIFO packet in one burst.
+static const int kBytesPerSample = kFifoBurstOverhead + kFifoPacketSize;
+static const int kNumTrials = 500;
+// Above this fraction of the sample period, a single stall is likely to drop edges.
+static const double kWarnLoad = 0.5;
+
+bool SelfCheckPipeline(const ImuConfig_t* config)
+{
+  const double period = 1.0 / config->odr_hz;
+  const double wire_time = kBytesPerSample * 8.0 / config->spi_speed_hz;
+
+  // Time the real SPI read path.
+  double spi_total = 0, spi_max = 0;
+  static ImuBlock_t block;
+  for (int i = 0; i < kNumTrials; i++)
+  {
+    timespec before, after;
+    GetMonotonic(&before);
+    SpiImuReadBlock(&block, 1);
+    GetMonotonic(&after);
+    double elapsed = TimespecDiff(before, after);
+    spi_total += elapsed;
+    if (elapsed > spi_max)
+      spi_max = elapsed;
+  }
+
+  // Time fusion (if enabled) and CSV formatting without disk latency.
+  FILE *null_file = fopen("/dev/null", "w");
+  static FusionState_t fusion_state;
+  FusionInit(&fusion_state, 1, config);
+  double log_total = 0, log_max = 0;
+  for (int i = 0; null_file != NULL && i < kNumTrials; i++)
+  {
+    timespec before, after;
+    GetMonotonic(&before);
+    // Whatever the last read left, as one sample.
+    block.num_samples = 1;
+    block.t_ns[0] = i * (int64_t)(period * 1e9);
+    FusionOutput_t fusion_out;
+    if (config->fusion)
+    {
+      const ImuSample_t sample = ImuBlockGetSample(&block, 0);
+      FusionUpdate(&fusion_state, &sample);
+      fusion_out = FusionGetOutput(&fusion_state, 0);
+    }
+    CsvWriteBlock(null_file, &block, config->fusion ? &fusion_out : NULL);
+    GetMonotonic(&after);
+    double elapsed = TimespecDiff(before, after);
+    log_total += elapsed;
+    if (elapsed > log_max)
+      log_max = elapsed;
+  }
+  if (null_file != NULL)
+    fclose(null_file);
+
+  const double mean_cost = (spi_total + log_total) / kNumTrials;
+  const double load = mean_cost / period;
+  printf("Self-check: ODR %d Hz (period %.1f us), SPI %u Hz\n"
+         "  SPI wire time %.1f us, SPI read mean %.1f us max %.1f us\n"
+         "  Log path (fusion, csv format) mean %.1f us max %.1f us\n"
+         "  Estimated load %.0f%% of the sample period\n",
+         config->odr_hz, period * 1e6, config->spi_speed_hz,
+         wire_time * 1e6, spi_total / kNumTrials * 1e6, spi_max * 1e6,
+         log_total / kNumTrials * 1e6, log_max * 1e6,
+         load * 100);
+
+  if (wire_time >= period || load >= 1.0)
+  {
+    printf("ERROR: The pipeline cannot sustain %d Hz. Lower the ODR or raise the SPI clock.\n",
+           config->odr_hz);
+    return false;
+  }
+  if (load > kWarnLoad || spi_max + log_max > period)
+    printf("WARNING: Little headroom at %d Hz, stalls will drop or delay samples.\n", config->odr_hz);
+  return true;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "config.h"
+
+// Time the SPI read and CSV logging paths and compare them against the sample period.
+// Returns false if the requested ODR cannot be sustained.
+bool SelfCheckPipeline(const ImuConfig_t* config);
@@ -1,15 +1,25 @@
 #include "spi.h"
 
 #include <fcntl.h>
+#include <stdbool.h>
 #include <linux/spi/spidev.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
+#include "config.h"
 #include "imu.h"
+#include "imu_block.h"
 
 int spi_file_desc = -1; // -1 is null file descriptor value I think.
+uint32_t spi_speed_hz = 1000000; // Overwritten by InitSpiDevice().
+
+// SpiImuReadParse() state.
+static int fifo_backlog = 0;        // Packets left in the FIFO after the last burst.
+static double period_ticks = 250;   // Sample period in timestamp ticks.
+static uint16_t prev_tmst = 0;      // Timestamp of the last accepted sample.
+static bool have_prev_sample = false;
 
 // Function to open the SPI device
 int spi_open(const char *device, int mode)
@@ -28,6 +38,14 @@ int spi_open(const char *device, int mode)
     close(file_desc);
     return -1;
   }
+
+  // Raise the driver's max speed so per-transfer speeds above the default are honoured.
+  if (ioctl(file_desc, SPI_IOC_WR_MAX_SPEED_HZ, &spi_speed_hz) == -1)
+  {
+    perror("Can't set SPI max speed");
+    close(file_desc);
+    return -1;
+  }
   return file_desc;
 }
 
@@ -38,48 +56,141 @@ int spi_transfer(int file_desc, uint8_t *tx_buffer, uint8_t *rx_buffer, size_t l
       .tx_buf = (unsigned long)tx_buffer,
       .rx_buf = (unsigned long)rx_buffer,
       .len = len,
-      .speed_hz = 1e6,
+      .speed_hz = spi_speed_hz,
       .bits_per_word = 8,
   };
 
   return ioctl(file_desc, SPI_IOC_MESSAGE(1), &spi_transfer);
 }
 
-void InitSpiDevice()
+void InitSpiDevice(const ImuConfig_t *config)
 {
   const char *device_name = "/dev/spidev0.0"; // Use /dev/spidev0.1 for the second chip select
   int spi_mode = 3;
+  spi_speed_hz = config->spi_speed_hz;
+  period_ticks = 1.0 / (config->odr_hz * IMU_TMST_TICK_S);
   spi_file_desc = spi_open(device_name, spi_mode);
   if (spi_file_desc < 0)
   {
     perror("Cant open SPI device.");
   }
-  ImuInitRegisters(spi_file_desc);
+  ImuInitRegisters(spi_file_desc, config);
+}
+
+void SpiImuConfigure(const ImuConfig_t *config)
+{
+  spi_speed_hz = config->spi_speed_hz;
+  period_ticks = 1.0 / (config->odr_hz * IMU_TMST_TICK_S);
+  if (ioctl(spi_file_desc, SPI_IOC_WR_MAX_SPEED_HZ, &spi_speed_hz) == -1)
+    perror("Can't set SPI max speed");
+  ImuInitRegisters(spi_file_desc, config);
+}
+
+// Discard whatever the FIFO holds.
+static void SpiImuFlushFifo()
+{
+  uint8_t spi_out[2] = {kSignalPathReset, 0b00000010}, spi_in[2];
+  spi_transfer(spi_file_desc, spi_out, spi_in, 2);
+  fifo_backlog = 0;
 }
 
-ImuSample_t SpiImuReadParse()
+// Start a recording with an empty FIFO and cleared validity counters.
+void SpiImuStartStream()
 {
-  uint8_t spi_out[13] = {0},
-          spi_in[13] = {0}; // 13 is enough to read all IMU data.
-  spi_out[0] = 0x1f | 0x80; // AccelX1 register address with reading bit (0x80) set.
-  if (spi_transfer(spi_file_desc, spi_out, spi_in, 13) == -1)
+  SpiImuFlushFifo();
+  gImuReadStats = (ImuReadStats_t){0};
+  have_prev_sample = false;
+}
+
+// Pop the newest FIFO packets in a single SPI transaction and keep only valid, new samples.
+// The burst starts at INT_STATUS so the data-ready flag and FIFO count come with the data.
+// Normally one packet is popped, a backlog seen in the previous burst is popped as well.
+// The whole burst is byte-swapped into the block in one pass, then rejected samples are squeezed out.
+int SpiImuReadBlock(ImuBlock_t *block, int max_samples)
+{
+  uint8_t spi_out[kFifoBurstOverhead + kFifoPacketSize * kFifoMaxBurstPackets] = {0},
+          spi_in[kFifoBurstOverhead + kFifoPacketSize * kFifoMaxBurstPackets] = {0};
+  int num_packets = 1 + fifo_backlog;
+  if (num_packets > kFifoMaxBurstPackets)
+    num_packets = kFifoMaxBurstPackets;
+  if (num_packets > max_samples)
+    num_packets = max_samples;
+  block->num_samples = 0;
+
+  spi_out[0] = kIntStatus | 0x80; // INT_STATUS register address with reading bit (0x80) set.
+  if (spi_transfer(spi_file_desc, spi_out, spi_in, kFifoBurstOverhead + kFifoPacketSize * num_packets) == -1)
   {
     perror("SPI transfer failed");
     close(spi_file_desc);
     exit(1);
   }
+  gImuReadStats.edges++;
+
+  const uint8_t int_status = spi_in[1];
+  const int fifo_count = (spi_in[2] << 8) | spi_in[3]; // In records, before this pop.
+  if (int_status & kIntStatusFifoFull)
+    gImuReadStats.overflows++;
+  if (fifo_count == 0)
+  {
+    // Spurious edge, nothing new. Any bytes clocked out are the empty marker.
+    gImuReadStats.empty++;
+    fifo_backlog = 0;
+    return 0;
+  }
+  if (num_packets > fifo_count)
+    num_packets = fifo_count;
+  fifo_backlog = fifo_count - num_packets;
+  if (fifo_backlog > gImuReadStats.max_backlog)
+    gImuReadStats.max_backlog = fifo_backlog;
 
-  ImuSample_t imu_data_notime = {0,
-                                 (spi_in[1] << 8) + spi_in[2],
-                                 (spi_in[3] << 8) + spi_in[4],
-                                 (spi_in[5] << 8) + spi_in[6],
-                                 (spi_in[7] << 8) + spi_in[8],
-                                 (spi_in[9] << 8) + spi_in[10],
-                                 (spi_in[11] << 8) + spi_in[12]};
+  ImuBlockParseFifo(block, &spi_in[kFifoBurstOverhead], num_packets);
+  int num_samples = 0;
+  for (int i = 0; i < num_packets; i++)
+  {
+    const uint16_t header = block->header[i];
+    const int16_t ax = block->ch[0][i], gx = block->ch[3][i];
+    const uint16_t tmst = block->tmst[i];
 
-  spi_out[0] = 0x80 | 0x2d;
-  spi_out[1] = 0;
-  spi_transfer(spi_file_desc, spi_out, spi_in, 2);
+    // A bad header means the packet boundary was lost, flush to realign.
+    if ((header & kFifoHeaderMask) != kFifoHeaderExpected)
+    {
+      if (header & kFifoHeaderEmpty)
+      {
+        gImuReadStats.empty++;
+        continue;
+      }
+      gImuReadStats.invalid++;
+      SpiImuFlushFifo();
+      break;
+    }
+    if (ax == kFifoInvalidSample || gx == kFifoInvalidSample)
+    {
+      gImuReadStats.invalid++;
+      continue;
+    }
 
-  return imu_data_notime;
-}
\ No newline at end of file
+    if (have_prev_sample)
+    {
+      const uint16_t delta = tmst - prev_tmst;
+      if (delta == 0)
+      {
+        gImuReadStats.duplicates++;
+        continue;
+      }
+      if (delta > 1.5 * period_ticks)
+      {
+        gImuReadStats.gaps++;
+        gImuReadStats.missing += (uint64_t)(delta / period_ticks + 0.5) - 1;
+      }
+    }
+    prev_tmst = tmst;
+    have_prev_sample = true;
+    if (num_samples != i)
+      ImuBlockMoveSample(block, num_samples, i);
+    num_samples++;
+  }
+  block->num_samples = num_samples;
+
+  gImuReadStats.samples += num_samples;
+  return num_samples;
+}
@@ -2,9 +2,15 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include "config.h"
 #include "imu.h"
+#include "imu_block.h"
 
 int spi_open(const char* device, int mode);
 int spi_transfer(int file_desc, uint8_t* tx_buffer, uint8_t* rx_buffer, size_t len);
-void InitSpiDevice();
-ImuSample_t SpiImuReadParse();
+void InitSpiDevice(const ImuConfig_t* config);
+// Apply new rate, range and SPI clock settings to an open device.
+void SpiImuConfigure(const ImuConfig_t* config);
+void SpiImuStartStream();
+// One burst of valid, new samples into block, t_ns not set. Returns block->num_samples.
+int SpiImuReadBlock(ImuBlock_t* block, int max_samples);
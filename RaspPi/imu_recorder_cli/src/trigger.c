@@ -0,0 +1,148 @@
+#include "trigger.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "csv.h"
+#include "fusion.h"
+#include "imu.h"
+
+// Removes gravity and slow orientation changes from the accel magnitude.
+static const float kHighPassHz = 20.0f;
+// Short-term energy window.
+static const float kEnergyTimeConstant = 0.02f;
+
+void TriggerInit(Trigger_t *trigger, const ImuConfig_t *config, const char *session_name)
+{
+  memset(trigger, 0, sizeof(*trigger));
+  trigger->config = config;
+  snprintf(trigger->session_name, sizeof(trigger->session_name), "%s", session_name);
+
+  const float dt = 1.0f / config->odr_hz;
+  const float rc = 1.0f / (2.0f * (float)M_PI * kHighPassHz);
+  trigger->accel_scale = config->accel_fs_g / 32768.0f;
+  trigger->hp_alpha = rc / (rc + dt);
+  trigger->energy_alpha = dt / (kEnergyTimeConstant + dt);
+  trigger->post_samples = config->trigger_post_s * config->odr_hz;
+
+  trigger->capacity = config->trigger_pre_s * config->odr_hz + 1;
+  trigger->ring = malloc(sizeof(TriggerEntry_t) * trigger->capacity);
+  if (trigger->ring == NULL)
+  {
+    printf("ERROR: Could not allocate the %d sample pre-trigger ring\n", trigger->capacity);
+    exit(1);
+  }
+}
+
+static void TriggerWriteEntry(const Trigger_t *trigger, const TriggerEntry_t *entry)
+{
+  CsvWriteSample(gImuCsvFd, &entry->sample, trigger->config->fusion ? &entry->fusion : NULL);
+  WriteWavSample(&entry->sample);
+}
+
+// Open the episode file and write the pre-trigger context held in the ring.
+static void TriggerStartEpisode(Trigger_t *trigger, double t)
+{
+  trigger->active = true;
+  trigger->quiet_samples = 0;
+  trigger->contact_start = t;
+  trigger->last_loud = t;
+  trigger->episode++;
+  trigger->stats_at_start = gImuReadStats;
+
+  char name[96];
+  snprintf(name, sizeof(name), "%s_ep%03d", trigger->session_name, trigger->episode);
+  gImuCsvFd = OpenCsv(name);
+  OpenWav(name, trigger->config);
+  ConfigWriteHeader(gImuCsvFd, trigger->config);
+  fprintf(gImuCsvFd, "# episode=%d\n# contact_start=%f\n", trigger->episode, t);
+  CsvWriteColumnNames(gImuCsvFd, trigger->config);
+
+  // The ring holds the newest entry too, that one is written by TriggerPush().
+  uint64_t num_context = trigger->num_pushed - 1;
+  if (num_context > (uint64_t)trigger->capacity - 1)
+    num_context = trigger->capacity - 1;
+  for (uint64_t i = trigger->num_pushed - 1 - num_context; i < trigger->num_pushed - 1; i++)
+    TriggerWriteEntry(trigger, &trigger->ring[i % trigger->capacity]);
+}
+
+// Label the episode with its contact times, close it and add it to the session index.
+static void TriggerEndEpisode(Trigger_t *trigger, double t)
+{
+  fprintf(gImuCsvFd, "# contact_stop=%f\n# segment_stop=%f\n", trigger->last_loud, t);
+  // Reads while the episode was open, the pre-trigger context came from earlier ones.
+  const ImuReadStats_t stats = ImuStatsSince(&gImuReadStats, &trigger->stats_at_start);
+  CloseCsvWithStats(&stats);
+  trigger->active = false;
+
+  char name[96];
+  snprintf(name, sizeof(name), "%s_episodes", trigger->session_name);
+  FILE *index = OpenCsvAppend(name);
+  if (index == NULL)
+    return;
+  fseek(index, 0, SEEK_END);
+  if (ftell(index) == 0)
+    fprintf(index, "episode, file, contact_start, contact_stop\n");
+  fprintf(index, "%d, %s_ep%03d.csv, %f, %f\n",
+          trigger->episode, trigger->session_name, trigger->episode,
+          trigger->contact_start, trigger->last_loud);
+  fclose(index);
+}
+
+void TriggerPush(Trigger_t *trigger, const ImuSample_t *sample, const FusionOutput_t *fusion)
+{
+  TriggerEntry_t *entry = &trigger->ring[trigger->num_pushed % trigger->capacity];
+  entry->sample = *sample;
+  if (fusion != NULL)
+    entry->fusion = *fusion;
+  trigger->num_pushed++;
+
+  // Short-term energy of the high-passed accel magnitude, in g^2.
+  float mag = sqrtf((float)sample->ax * sample->ax + (float)sample->ay * sample->ay +
+                    (float)sample->az * sample->az) *
+              trigger->accel_scale;
+  if (trigger->have_prev == false)
+  {
+    trigger->prev_mag = mag;
+    trigger->have_prev = true;
+  }
+  trigger->hp = trigger->hp_alpha * (trigger->hp + mag - trigger->prev_mag);
+  trigger->prev_mag = mag;
+  trigger->energy += trigger->energy_alpha * (trigger->hp * trigger->hp - trigger->energy);
+  const float level = sqrtf(trigger->energy); // g rms.
+
+  if (trigger->active == false)
+  {
+    if (level > trigger->config->trigger_on_g)
+      TriggerStartEpisode(trigger, sample->t);
+    else
+      return;
+  }
+
+  TriggerWriteEntry(trigger, entry);
+  if (level > trigger->config->trigger_off_g)
+  {
+    trigger->quiet_samples = 0;
+    trigger->last_loud = sample->t;
+  }
+  else if (++trigger->quiet_samples >= trigger->post_samples)
+  {
+    TriggerEndEpisode(trigger, sample->t);
+  }
+}
+
+void TriggerFinish(Trigger_t *trigger)
+{
+  if (trigger->active)
+  {
+    const TriggerEntry_t *newest = &trigger->ring[(trigger->num_pushed - 1) % trigger->capacity];
+    TriggerEndEpisode(trigger, newest->sample.t);
+  }
+  printf("%d contact episodes recorded\n", trigger->episode);
+  free(trigger->ring);
+  trigger->ring = NULL;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "fusion.h"
+#include "imu.h"
+
+// One sample as it will be written, kept in the pre-trigger ring.
+typedef struct {
+  ImuSample_t sample;
+  FusionOutput_t fusion;
+} TriggerEntry_t;
+
+// Contact detector on the accel magnitude with a pre-trigger ring buffer.
+// Only contact episodes plus pre/post context are written, each to its own csv.
+typedef struct {
+  const ImuConfig_t* config;
+  char session_name[64];
+  int episode;
+
+  // Detector: high-passed accel magnitude, then short-term energy (EMA of the square).
+  float accel_scale;
+  float hp_alpha, energy_alpha;
+  float prev_mag, hp, energy;
+  bool have_prev;
+
+  // Hysteresis: start above on_level, stop after post_samples below off_level.
+  bool active;
+  int quiet_samples;
+  int post_samples;
+  double contact_start, last_loud;
+
+  // Last pre_samples entries before a trigger.
+  TriggerEntry_t* ring;
+  int capacity;
+  uint64_t num_pushed;
+
+  // gImuReadStats when the open episode started, its file gets the counters since then.
+  ImuReadStats_t stats_at_start;
+} Trigger_t;
+
+void TriggerInit(Trigger_t* trigger, const ImuConfig_t* config, const char* session_name);
+// fusion may be NULL when fusion columns are disabled.
+void TriggerPush(Trigger_t* trigger, const ImuSample_t* sample, const FusionOutput_t* fusion);
+// Close an open episode and free the ring.
+void TriggerFinish(Trigger_t* trigger);
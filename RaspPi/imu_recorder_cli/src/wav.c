@@ -0,0 +1,200 @@
+#include "wav.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// DC removal time constant in float mode, the stream equivalent of subtracting the mean.
+static const float kDcTimeConstant = 1.0f;
+
+int WavParseFormat(const char* name)
+{
+  if (strcmp(name, "off") == 0 || strcmp(name, "0") == 0)
+    return kWavOff;
+  if (strcmp(name, "int16") == 0)
+    return kWavInt16;
+  if (strcmp(name, "float") == 0)
+    return kWavFloat;
+  return -1;
+}
+
+const char* WavFormatName(WavFormat_t format)
+{
+  switch (format)
+  {
+  case kWavInt16:
+    return "int16";
+  case kWavFloat:
+    return "float";
+  default:
+    return "off";
+  }
+}
+
+static void PutLe16(uint8_t* p, uint16_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void PutLe32(uint8_t* p, uint32_t v)
+{
+  PutLe16(p, v);
+  PutLe16(p + 2, v >> 16);
+}
+
+// Header size depends on the format: 44 bytes for PCM, 58 for float (fmt extension plus fact chunk).
+static size_t WavHeaderSize(WavFormat_t format)
+{
+  return format == kWavFloat ? 58 : 44;
+}
+
+static size_t WavBuildHeader(const WavWriter_t* wav, uint8_t* header)
+{
+  const bool is_float = wav->format == kWavFloat;
+  const uint16_t bytes_per_value = is_float ? 4 : 2;
+  const size_t header_size = WavHeaderSize(wav->format);
+  const uint64_t data_bytes = wav->frames * WAV_CHANNELS * bytes_per_value;
+  // Sizes saturate past 4GB, readers then fall back to the file length.
+  const uint32_t data_size = data_bytes > UINT32_MAX - header_size ? UINT32_MAX - header_size : data_bytes;
+
+  uint8_t* p = header;
+  memcpy(p, "RIFF", 4);
+  PutLe32(p + 4, data_size + header_size - 8);
+  memcpy(p + 8, "WAVE", 4);
+  memcpy(p + 12, "fmt ", 4);
+  PutLe32(p + 16, is_float ? 18 : 16);
+  PutLe16(p + 20, is_float ? 3 : 1); // WAVE_FORMAT_IEEE_FLOAT or WAVE_FORMAT_PCM.
+  PutLe16(p + 22, WAV_CHANNELS);
+  PutLe32(p + 24, wav->rate_hz);
+  PutLe32(p + 28, wav->rate_hz * WAV_CHANNELS * bytes_per_value);
+  PutLe16(p + 32, WAV_CHANNELS * bytes_per_value);
+  PutLe16(p + 34, bytes_per_value * 8);
+  p += 36;
+  if (is_float)
+  {
+    PutLe16(p, 0);
+    memcpy(p + 2, "fact", 4);
+    PutLe32(p + 6, 4);
+    PutLe32(p + 10, wav->frames > UINT32_MAX ? UINT32_MAX : wav->frames);
+    p += 14;
+  }
+  memcpy(p, "data", 4);
+  PutLe32(p + 4, data_size);
+  return header_size;
+}
+
+int WavOpen(WavWriter_t* wav, const char* path, WavFormat_t format, double input_rate_hz)
+{
+  memset(wav, 0, sizeof(*wav));
+  wav->format = format;
+  if (format == kWavFloat)
+  {
+    wav->rate_hz = WAV_FLOAT_RATE_HZ;
+    wav->step = input_rate_hz / WAV_FLOAT_RATE_HZ;
+    wav->dc_alpha = 1.0f / (kDcTimeConstant * input_rate_hz);
+  }
+  else
+  {
+    wav->rate_hz = lround(input_rate_hz);
+  }
+
+  wav->file = fopen(path, "wb");
+  if (wav->file == NULL)
+    return -1;
+  uint8_t header[64];
+  size_t header_size = WavBuildHeader(wav, header);
+  if (fwrite(header, 1, header_size, wav->file) != header_size)
+  {
+    fclose(wav->file);
+    wav->file = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+void WavWriteSample(WavWriter_t* wav, const int16_t counts[WAV_CHANNELS])
+{
+  if (wav->file == NULL)
+    return;
+  if (wav->format == kWavInt16)
+  {
+    // wav is little endian like the Pi, so the counts go out as they are.
+    fwrite(counts, sizeof(int16_t), WAV_CHANNELS, wav->file);
+    wav->frames++;
+    return;
+  }
+
+  float x[WAV_CHANNELS];
+  for (int c = 0; c < WAV_CHANNELS; c++)
+  {
+    x[c] = counts[c] / 32768.0f;
+    if (wav->have_prev == false)
+      wav->dc[c] = x[c];
+    wav->dc[c] += wav->dc_alpha * (x[c] - wav->dc[c]);
+    x[c] -= wav->dc[c];
+  }
+  if (wav->have_prev == false)
+  {
+    memcpy(wav->prev, x, sizeof(x));
+    wav->have_prev = true;
+    return;
+  }
+
+  // Output frames that fall between the previous and this input sample.
+  for (; wav->phase < 1.0; wav->phase += wav->step)
+  {
+    float frame[WAV_CHANNELS];
+    const float a = wav->phase;
+    for (int c = 0; c < WAV_CHANNELS; c++)
+      frame[c] = wav->prev[c] + (x[c] - wav->prev[c]) * a;
+    fwrite(frame, sizeof(float), WAV_CHANNELS, wav->file);
+    wav->frames++;
+  }
+  wav->phase -= 1.0;
+  memcpy(wav->prev, x, sizeof(x));
+}
+
+void WavWriteChannels(WavWriter_t* wav, const int16_t* const channels[WAV_CHANNELS], int num_frames)
+{
+  if (wav->file == NULL)
+    return;
+  if (wav->format != kWavInt16)
+  {
+    for (int i = 0; i < num_frames; i++)
+    {
+      int16_t counts[WAV_CHANNELS];
+      for (int c = 0; c < WAV_CHANNELS; c++)
+        counts[c] = channels[c][i];
+      WavWriteSample(wav, counts);
+    }
+    return;
+  }
+
+  // Interleave in chunks that fit the stack.
+  int16_t frames[256][WAV_CHANNELS];
+  for (int first = 0; first < num_frames; first += 256)
+  {
+    const int n = num_frames - first < 256 ? num_frames - first : 256;
+    for (int i = 0; i < n; i++)
+      for (int c = 0; c < WAV_CHANNELS; c++)
+        frames[i][c] = channels[c][first + i];
+    fwrite(frames, sizeof(frames[0]), n, wav->file);
+    wav->frames += n;
+  }
+}
+
+int WavClose(WavWriter_t* wav)
+{
+  if (wav->file == NULL)
+    return 0;
+  uint8_t header[64];
+  size_t header_size = WavBuildHeader(wav, header);
+  int ok = ferror(wav->file) == 0 && fseek(wav->file, 0, SEEK_SET) == 0 &&
+           fwrite(header, 1, header_size, wav->file) == header_size;
+  ok = fclose(wav->file) == 0 && ok;
+  wav->file = NULL;
+  return ok ? 0 : -1;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Channels written, ax, ay, az, gx, gy, gz in that order.
+#define WAV_CHANNELS 6
+// Output rate of kWavFloat, what audio models like CLAP expect.
+#define WAV_FLOAT_RATE_HZ 48000
+
+typedef enum {
+  kWavOff = 0,
+  kWavInt16, // Raw counts at the IMU ODR, lossless.
+  kWavFloat, // Full scale = 1.0, DC removed, linearly resampled to WAV_FLOAT_RATE_HZ.
+} WavFormat_t;
+
+// Streaming multi-channel wav. Samples go straight to the file, so memory stays constant
+// however long the recording. The size fields are written as 0 and patched by WavClose().
+typedef struct {
+  FILE* file;
+  WavFormat_t format;
+  uint32_t rate_hz; // Rate in the header.
+  uint64_t frames;  // Frames written so far.
+
+  // kWavFloat only.
+  double step;  // Input samples per output frame.
+  double phase; // Position of the next output frame after prev, in input samples.
+  bool have_prev;
+  float prev[WAV_CHANNELS];
+  float dc[WAV_CHANNELS];
+  float dc_alpha;
+} WavWriter_t;
+
+// Parse "off", "int16" or "float". Returns -1 for anything else.
+int WavParseFormat(const char* name);
+const char* WavFormatName(WavFormat_t format);
+
+// Open path for samples arriving at input_rate_hz. Returns 0, or -1 with errno set.
+int WavOpen(WavWriter_t* wav, const char* path, WavFormat_t format, double input_rate_hz);
+// One sample of every channel in raw counts. Does nothing if the writer isn't open.
+void WavWriteSample(WavWriter_t* wav, const int16_t counts[WAV_CHANNELS]);
+// num_frames samples stored by channel, channels[c][i]. int16 files get one fwrite per call.
+void WavWriteChannels(WavWriter_t* wav, const int16_t* const channels[WAV_CHANNELS], int num_frames);
+// Patch the header sizes and close. Returns 0 if everything reached the file.
+int WavClose(WavWriter_t* wav);
@@ -0,0 +1,302 @@
+// Builds the windowed feature dataset of processData.m from a folder of recordings, one file per thread.
+// Output: features.npy (float32 [windows, 64]), labels.npy (int32 class index), classes.txt, columns.txt.
+#define _DEFAULT_SOURCE
+
+#include <dirent.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "window_features.h"
+#include "npy.h"
+#include "recording.h"
+
+#define MAX_FILES 4096
+#define MAX_CLASSES 256
+
+typedef struct {
+  char path[512];
+  char label[64];
+  size_t num_windows;
+  float* features; // [num_windows][FEATURE_COUNT], NULL if the file gave none.
+} FileResult_t;
+
+typedef struct {
+  FileResult_t* files;
+  int num_files;
+  atomic_int next_file; // Workers take files in order until this passes num_files.
+  bool verbose;
+} Job_t;
+
+static double NowSeconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void ProcessFile(FileResult_t* file, FeatureExtractor_t* ext, bool verbose)
+{
+  Recording_t rec;
+  file->num_windows = 0;
+  file->features = NULL;
+  if (RecordingLoad(&rec, file->path) != 0)
+    return;
+  if (rec.num_columns < 1 + RECORDING_CHANNELS)
+  {
+    RecordingFree(&rec);
+    return;
+  }
+  double* clean[RECORDING_CHANNELS];
+  size_t n = FeaturePreprocess(&rec, &ext->params, clean);
+  RecordingFree(&rec);
+  if (n == 0)
+    return;
+  file->num_windows = FeatureExtract(ext, clean, n, &file->features);
+  for (int c = 0; c < RECORDING_CHANNELS; c++)
+    free(clean[c]);
+  if (verbose && file->num_windows > 0)
+    printf("Processed: %s (Yielded %zu windows)\n", file->path, file->num_windows);
+}
+
+static void* Worker(void* arg)
+{
+  Job_t* job = arg;
+  FeatureExtractor_t ext;
+  FeatureExtractorInit(&ext, &kDefaultFeatureParams);
+  for (int i; (i = atomic_fetch_add(&job->next_file, 1)) < job->num_files;)
+    ProcessFile(&job->files[i], &ext, job->verbose);
+  FeatureExtractorFree(&ext);
+  return NULL;
+}
+
+// Process every file on num_threads threads. Returns the wall time in seconds.
+static double RunJob(FileResult_t* files, int num_files, int num_threads, bool verbose)
+{
+  for (int i = 0; i < num_files; i++)
+    free(files[i].features);
+  Job_t job = {.files = files, .num_files = num_files, .verbose = verbose};
+  atomic_init(&job.next_file, 0);
+  pthread_t threads[num_threads];
+  double start = NowSeconds();
+  for (int t = 0; t < num_threads; t++)
+    pthread_create(&threads[t], NULL, Worker, &job);
+  for (int t = 0; t < num_threads; t++)
+    pthread_join(threads[t], NULL);
+  return NowSeconds() - start;
+}
+
+static int CompareStrings(const void* a, const void* b)
+{
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static int ListCsvFiles(const char* dir_path, FileResult_t* files)
+{
+  DIR* dir = opendir(dir_path);
+  if (dir == NULL)
+  {
+    perror(dir_path);
+    return -1;
+  }
+  static char names[MAX_FILES][256];
+  char* sorted[MAX_FILES];
+  int num_files = 0;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL && num_files < MAX_FILES)
+  {
+    size_t len = strlen(entry->d_name);
+    if (len < 4 || strcmp(entry->d_name + len - 4, ".csv") != 0)
+      continue;
+    // The trigger's episode index, not a recording.
+    if (len >= 13 && strcmp(entry->d_name + len - 13, "_episodes.csv") == 0)
+      continue;
+    snprintf(names[num_files], sizeof(names[0]), "%s", entry->d_name);
+    sorted[num_files] = names[num_files];
+    num_files++;
+  }
+  closedir(dir);
+  // Same order as MATLAB's dir(), so the rows line up with processData.m.
+  qsort(sorted, num_files, sizeof(char*), CompareStrings);
+  for (int i = 0; i < num_files; i++)
+  {
+    memset(&files[i], 0, sizeof(files[i]));
+    snprintf(files[i].path, sizeof(files[i].path), "%s/%s", dir_path, sorted[i]);
+    RecordingClassFromPath(sorted[i], files[i].label, sizeof(files[i].label));
+  }
+  return num_files;
+}
+
+static int WriteDataset(const char* out_dir, const FileResult_t* files, int num_files)
+{
+  // Classes sorted like categorical().
+  char* classes[MAX_CLASSES];
+  int num_classes = 0;
+  size_t num_windows = 0;
+  for (int i = 0; i < num_files; i++)
+  {
+    if (files[i].num_windows == 0)
+      continue;
+    num_windows += files[i].num_windows;
+    bool known = false;
+    for (int c = 0; c < num_classes && known == false; c++)
+      known = strcmp(classes[c], files[i].label) == 0;
+    if (known == false && num_classes < MAX_CLASSES)
+      classes[num_classes++] = (char*)files[i].label;
+  }
+  qsort(classes, num_classes, sizeof(char*), CompareStrings);
+
+  float* features = malloc(sizeof(float) * FEATURE_COUNT * (num_windows ? num_windows : 1));
+  int32_t* labels = malloc(sizeof(int32_t) * (num_windows ? num_windows : 1));
+  size_t row = 0;
+  for (int i = 0; i < num_files; i++)
+  {
+    if (files[i].num_windows == 0)
+      continue;
+    int class_index = 0;
+    while (strcmp(classes[class_index], files[i].label) != 0)
+      class_index++;
+    memcpy(&features[row * FEATURE_COUNT], files[i].features, sizeof(float) * FEATURE_COUNT * files[i].num_windows);
+    for (size_t w = 0; w < files[i].num_windows; w++)
+      labels[row + w] = class_index;
+    row += files[i].num_windows;
+  }
+
+  char path[512];
+  int status = 0;
+  snprintf(path, sizeof(path), "%s/features.npy", out_dir);
+  status |= NpyWrite(path, "<f4", sizeof(float), features, num_windows, FEATURE_COUNT);
+  snprintf(path, sizeof(path), "%s/labels.npy", out_dir);
+  status |= NpyWrite(path, "<i4", sizeof(int32_t), labels, num_windows, 0);
+  free(features);
+  free(labels);
+
+  snprintf(path, sizeof(path), "%s/classes.txt", out_dir);
+  FILE* file = fopen(path, "w");
+  if (file)
+  {
+    for (int c = 0; c < num_classes; c++)
+      fprintf(file, "%s\n", classes[c]);
+    status |= fclose(file);
+  }
+  else
+    status = -1;
+
+  snprintf(path, sizeof(path), "%s/columns.txt", out_dir);
+  file = fopen(path, "w");
+  if (file)
+  {
+    char names[FEATURE_COUNT][24];
+    FeatureNames(names);
+    for (int f = 0; f < FEATURE_COUNT; f++)
+      fprintf(file, "%s\n", names[f]);
+    status |= fclose(file);
+  }
+  else
+    status = -1;
+
+  if (status != 0)
+  {
+    perror(out_dir);
+    return -1;
+  }
+  printf("Final Dataset: %zu windows, %d features, %d classes in %s\n", num_windows, FEATURE_COUNT, num_classes,
+         out_dir);
+  return 0;
+}
+
+// Same files on 1, 2, 4, ... threads. The first pass warms the page cache so reads don't dominate.
+static void RunScaling(FileResult_t* files, int num_files, int max_threads)
+{
+  size_t num_windows = 0;
+  for (int i = 0; i < num_files; i++)
+    num_windows += files[i].num_windows;
+  double base = 0;
+  printf("%8s %10s %10s %12s %8s %10s\n", "threads", "seconds", "files/s", "windows/s", "speedup", "efficiency");
+  for (int threads = 1;; threads *= 2)
+  {
+    if (threads > max_threads)
+      threads = max_threads;
+    double seconds = RunJob(files, num_files, threads, false);
+    if (threads == 1)
+      base = seconds;
+    printf("%8d %10.3f %10.1f %12.0f %8.2f %9.0f%%\n", threads, seconds, num_files / seconds, num_windows / seconds,
+           base / seconds, 100 * base / seconds / threads);
+    if (threads == max_threads)
+      break;
+  }
+}
+
+static void PrintUsage(const char* argv0)
+{
+  printf("usage: %s [options] DATA_DIR\n"
+         "  -o, --out DIR      output directory (default .)\n"
+         "  -j, --threads N    worker threads (default: online cpus)\n"
+         "      --scaling      also time 1, 2, 4, ... threads up to -j\n"
+         "  -h, --help\n",
+         argv0);
+}
+
+int main(int argc, char** argv)
+{
+  const char* out_dir = ".";
+  int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  bool scaling = false;
+  static const struct option kLongOptions[] = {
+      {"out", required_argument, NULL, 'o'},
+      {"threads", required_argument, NULL, 'j'},
+      {"scaling", no_argument, NULL, 's'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "o:j:h", kLongOptions, NULL)) != -1)
+  {
+    switch (opt)
+    {
+    case 'o':
+      out_dir = optarg;
+      break;
+    case 'j':
+      num_threads = atoi(optarg);
+      break;
+    case 's':
+      scaling = true;
+      break;
+    case 'h':
+      PrintUsage(argv[0]);
+      return 0;
+    default:
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind != argc - 1 || num_threads < 1)
+  {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  static FileResult_t files[MAX_FILES];
+  int num_files = ListCsvFiles(argv[optind], files);
+  if (num_files < 0)
+    return 1;
+  printf("Found %d CSV files in %s\n", num_files, argv[optind]);
+
+  double seconds = RunJob(files, num_files, num_threads, true);
+  printf("%d files in %.3f s on %d threads\n", num_files, seconds, num_threads);
+  if (WriteDataset(out_dir, files, num_files) != 0)
+    return 1;
+  if (scaling)
+    RunScaling(files, num_files, num_threads);
+
+  for (int i = 0; i < num_files; i++)
+    free(files[i].features);
+  return 0;
+}
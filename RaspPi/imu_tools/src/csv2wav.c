@@ -0,0 +1,174 @@
+// Converts recorder csv files to 6 channel wav with the recorder's own wav writer.
+// Dropped samples (timestamp gaps) are filled by interpolation so the audio keeps real time.
+#define _DEFAULT_SOURCE
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "recording.h"
+#include "wav.h"
+
+// Steps longer than this many sample periods count as a gap, same threshold as the recorder.
+static const double kGapPeriods = 1.5;
+
+// The recorder writes "# odr_hz", older files only have the time column. The estimate is the median
+// step between distinct times, so duplicated samples don't count as extra rate.
+static double RecordingRateHz(const Recording_t* rec)
+{
+  const char* odr = RecordingMeta(rec, "odr_hz");
+  if (odr != NULL && atof(odr) > 0)
+    return atof(odr);
+  const double median = RecordingMedianStep(rec);
+  return median > 0 ? 1.0 / (median * RecordingTimeScale(rec)) : 0;
+}
+
+static int16_t ToCount(double value)
+{
+  if (isnan(value))
+    return 0;
+  return value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : (int16_t)lrint(value);
+}
+
+static int ConvertFile(const char* in_path, const char* out_path, WavFormat_t format)
+{
+  Recording_t rec;
+  if (RecordingLoad(&rec, in_path) != 0)
+    return -1;
+  const double rate_hz = RecordingRateHz(&rec);
+  // The wav header holds a whole number of Hz.
+  if (!(rate_hz >= 1 && lround(rate_hz) >= 1 && rate_hz < UINT32_MAX))
+  {
+    printf("%s: no usable sample rate (%g Hz)\n", in_path, rate_hz);
+    RecordingFree(&rec);
+    return -1;
+  }
+
+  WavWriter_t wav;
+  if (WavOpen(&wav, out_path, format, rate_hz) != 0)
+  {
+    perror(out_path);
+    RecordingFree(&rec);
+    return -1;
+  }
+
+  const double period = 1.0 / rate_hz / RecordingTimeScale(&rec); // In time column units.
+  uint64_t filled = 0, dropped = 0;
+  int16_t prev[WAV_CHANNELS] = {0};
+  for (size_t i = 0; i < rec.num_samples; i++)
+  {
+    int16_t counts[WAV_CHANNELS];
+    for (int c = 0; c < WAV_CHANNELS; c++)
+      counts[c] = isnan(rec.ch[c][i]) ? prev[c] : ToCount(rec.ch[c][i]);
+
+    // Repeated timestamps are the same sample read again, wav time must stay real time.
+    const double step = i > 0 ? rec.t[i] - rec.t[i - 1] : 0;
+    if (i > 0 && step <= 0)
+    {
+      dropped++;
+      continue;
+    }
+    if (step > kGapPeriods * period)
+    {
+      const long missing = lround(step / period) - 1;
+      for (long m = 1; m <= missing; m++)
+      {
+        int16_t fill[WAV_CHANNELS];
+        for (int c = 0; c < WAV_CHANNELS; c++)
+          fill[c] = ToCount(prev[c] + (double)(counts[c] - prev[c]) * m / (missing + 1));
+        WavWriteSample(&wav, fill);
+      }
+      filled += missing;
+    }
+    WavWriteSample(&wav, counts);
+    memcpy(prev, counts, sizeof(prev));
+  }
+
+  const uint64_t frames = wav.frames;
+  const uint32_t out_rate = wav.rate_hz;
+  int status = WavClose(&wav);
+  if (status != 0)
+    perror(out_path);
+  else
+    printf("%s: %zu samples at %.0f Hz, %llu filled, %llu repeated dropped -> %s (%llu frames at %u Hz)\n", in_path,
+           rec.num_samples, rate_hz, (unsigned long long)filled, (unsigned long long)dropped, out_path,
+           (unsigned long long)frames, out_rate);
+  RecordingFree(&rec);
+  return status;
+}
+
+static void PrintUsage(const char* argv0)
+{
+  printf("usage: %s [options] FILE.csv...\n"
+         "  -f, --format F   int16 (native ODR, default) or float (48kHz)\n"
+         "  -o, --out PATH   output file, only with a single input (default FILE.wav)\n"
+         "  -h, --help\n",
+         argv0);
+}
+
+int main(int argc, char** argv)
+{
+  WavFormat_t format = kWavInt16;
+  const char* out_path = NULL;
+  static const struct option kLongOptions[] = {
+      {"format", required_argument, NULL, 'f'},
+      {"out", required_argument, NULL, 'o'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "f:o:h", kLongOptions, NULL)) != -1)
+  {
+    switch (opt)
+    {
+    case 'f':
+    {
+      int parsed = WavParseFormat(optarg);
+      if (parsed <= kWavOff)
+      {
+        printf("Unknown format \"%s\"\n", optarg);
+        return 1;
+      }
+      format = parsed;
+      break;
+    }
+    case 'o':
+      out_path = optarg;
+      break;
+    case 'h':
+      PrintUsage(argv[0]);
+      return 0;
+    default:
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind >= argc || (out_path != NULL && argc - optind > 1))
+  {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  int failures = 0;
+  for (int i = optind; i < argc; i++)
+  {
+    char path[512];
+    if (out_path != NULL)
+    {
+      snprintf(path, sizeof(path), "%s", out_path);
+    }
+    else
+    {
+      snprintf(path, sizeof(path), "%s", argv[i]);
+      char* dot = strrchr(path, '.');
+      char* slash = strrchr(path, '/');
+      if (dot != NULL && (slash == NULL || dot > slash))
+        *dot = '\0';
+      strncat(path, ".wav", sizeof(path) - strlen(path) - 1);
+    }
+    failures += ConvertFile(argv[i], path, format) != 0;
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,492 @@
+// Checks recordings before training: sample intervals against the ODR, gaps, runs of identical
+// samples, saturation and cut-off records. One file per worker thread. Exits 1 if any file fails.
+#define _DEFAULT_SOURCE
+
+#include <dirent.h>
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "recording.h"
+
+#define MAX_FILES 4096
+// Interval histogram in units of the nominal sample period, upper edges of each bin.
+#define NUM_INTERVAL_BINS 8
+static const double kIntervalEdges[NUM_INTERVAL_BINS] = {0, 0.5, 0.9, 1.1, 1.5, 2.5, 10, INFINITY};
+static const char* kIntervalNames[NUM_INTERVAL_BINS] = {"<=0",     "0-0.5",   "0.5-0.9", "0.9-1.1",
+                                                        "1.1-1.5", "1.5-2.5", "2.5-10",  ">10"};
+static const char* kChannelNames[RECORDING_CHANNELS] = {"ax", "ay", "az", "gx", "gy", "gz"};
+// Steps longer than this many periods are gaps, same as the recorder's counter.
+static const double kGapPeriods = 1.5;
+
+// Pass/fail limits, set from the command line.
+typedef struct {
+  double odr_hz;           // Nominal rate, 0 to take it from "# odr_hz" or the median step.
+  double max_missing_pct;  // Samples lost in gaps.
+  double max_off_pct;      // Intervals outside 0.5..1.5 periods, spurious or late interrupts.
+  double max_saturated_pct;
+  int max_identical_run;   // Longest allowed run of identical rows, 8 for the old 8x bug.
+} QaLimits_t;
+
+typedef struct {
+  char path[512];
+  bool loaded;
+  size_t num_samples;
+  double duration_s;
+  double odr_hz;
+  const char* odr_source; // "option", "header" or "median".
+
+  uint64_t interval_hist[NUM_INTERVAL_BINS];
+  double interval_mean_us, interval_std_us, interval_min_us, interval_max_us;
+  uint64_t nonmonotonic; // Steps <= 0, duplicated or reordered timestamps.
+  uint64_t gaps, missing;
+  double longest_gap_s;
+  uint64_t identical_runs, identical_samples;
+  int longest_identical_run;
+  uint64_t saturated[RECORDING_CHANNELS];
+  size_t bad_rows;
+  bool truncated;
+
+  bool pass;
+  char failures[256]; // Comma separated reasons.
+} QaReport_t;
+
+typedef struct {
+  QaReport_t* reports;
+  int num_files;
+  const QaLimits_t* limits;
+  atomic_int next_file;
+} Job_t;
+
+static double NowSeconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void AddFailure(QaReport_t* report, const char* reason)
+{
+  size_t len = strlen(report->failures);
+  snprintf(report->failures + len, sizeof(report->failures) - len, "%s%s", len ? "," : "", reason);
+  report->pass = false;
+}
+
+static void AnalyzeFile(QaReport_t* report, const QaLimits_t* limits)
+{
+  Recording_t rec;
+  if (RecordingLoad(&rec, report->path) != 0)
+  {
+    AddFailure(report, "unreadable");
+    return;
+  }
+  report->loaded = true;
+  report->pass = true;
+  const size_t n = rec.num_samples;
+  report->num_samples = n;
+  report->bad_rows = rec.num_bad_rows;
+  report->truncated = rec.truncated;
+  if (n < 2)
+  {
+    AddFailure(report, "empty");
+    RecordingFree(&rec);
+    return;
+  }
+
+  // Nominal period, in seconds.
+  const double scale = RecordingTimeScale(&rec);
+  const char* header_odr = RecordingMeta(&rec, "odr_hz");
+  if (limits->odr_hz > 0)
+  {
+    report->odr_hz = limits->odr_hz;
+    report->odr_source = "option";
+  }
+  else if (header_odr != NULL && atof(header_odr) > 0)
+  {
+    report->odr_hz = atof(header_odr);
+    report->odr_source = "header";
+  }
+  else
+  {
+    // Over distinct times, duplicated samples would otherwise make the median step 0.
+    const double median = RecordingMedianStep(&rec);
+    report->odr_hz = median > 0 ? 1.0 / (median * scale) : 0;
+    report->odr_source = "median";
+  }
+  if (!(report->odr_hz > 0 && isfinite(report->odr_hz)))
+  {
+    report->odr_hz = 0;
+    AddFailure(report, "no_rate");
+    RecordingFree(&rec);
+    return;
+  }
+  const double period = 1.0 / report->odr_hz;
+  report->duration_s = (rec.t[n - 1] - rec.t[0]) * scale;
+
+  // Intervals and gaps.
+  double sum = 0, sum_sq = 0;
+  report->interval_min_us = INFINITY;
+  report->interval_max_us = -INFINITY;
+  for (size_t i = 1; i < n; i++)
+  {
+    const double dt = (rec.t[i] - rec.t[i - 1]) * scale;
+    const double periods = dt / period;
+    int bin = 0;
+    while (periods > kIntervalEdges[bin])
+      bin++;
+    report->interval_hist[bin]++;
+    report->nonmonotonic += dt <= 0;
+    if (periods > kGapPeriods)
+    {
+      report->gaps++;
+      report->missing += lround(periods) - 1;
+      if (dt > report->longest_gap_s)
+        report->longest_gap_s = dt;
+    }
+    sum += dt * 1e6;
+    sum_sq += dt * 1e6 * dt * 1e6;
+    report->interval_min_us = fmin(report->interval_min_us, dt * 1e6);
+    report->interval_max_us = fmax(report->interval_max_us, dt * 1e6);
+  }
+  report->interval_mean_us = sum / (n - 1);
+  report->interval_std_us = sqrt(fmax(0, sum_sq / (n - 1) - report->interval_mean_us * report->interval_mean_us));
+
+  // Identical rows and saturation.
+  int run = 1;
+  for (size_t i = 0; i < n; i++)
+  {
+    bool same = i > 0;
+    for (int c = 0; c < RECORDING_CHANNELS; c++)
+    {
+      const float v = rec.ch[c][i];
+      report->saturated[c] += v >= 32767 || v <= -32768;
+      same = same && v == rec.ch[c][i - 1];
+    }
+    if (same)
+    {
+      report->identical_samples++;
+      if (++run == 2)
+        report->identical_runs++;
+      if (run > report->longest_identical_run)
+        report->longest_identical_run = run;
+    }
+    else
+    {
+      run = 1;
+    }
+  }
+  RecordingFree(&rec);
+
+  // Verdict.
+  uint64_t off_period = 0, saturated = 0;
+  for (int b = 0; b < NUM_INTERVAL_BINS; b++)
+    off_period += kIntervalEdges[b] <= 0.5 || kIntervalEdges[b] > kGapPeriods ? report->interval_hist[b] : 0;
+  for (int c = 0; c < RECORDING_CHANNELS; c++)
+    saturated += report->saturated[c];
+  if (report->bad_rows > 0 || report->truncated)
+    AddFailure(report, "truncated");
+  if (report->nonmonotonic > 0)
+    AddFailure(report, "nonmonotonic");
+  if (100.0 * report->missing / (n + report->missing) > limits->max_missing_pct)
+    AddFailure(report, "gaps");
+  if (100.0 * off_period / (n - 1) > limits->max_off_pct)
+    AddFailure(report, "jitter");
+  if (report->longest_identical_run > limits->max_identical_run)
+    AddFailure(report, "identical");
+  if (100.0 * saturated / (n * RECORDING_CHANNELS) > limits->max_saturated_pct)
+    AddFailure(report, "saturated");
+}
+
+static void* Worker(void* arg)
+{
+  Job_t* job = arg;
+  for (int i; (i = atomic_fetch_add(&job->next_file, 1)) < job->num_files;)
+    AnalyzeFile(&job->reports[i], job->limits);
+  return NULL;
+}
+
+static bool IsRecording(const char* name)
+{
+  size_t len = strlen(name);
+  if (len >= 4 && strcmp(name + len - 4, ".bin") == 0)
+    return true;
+  // The trigger's episode index is not a recording.
+  return len >= 4 && strcmp(name + len - 4, ".csv") == 0 &&
+         (len < 13 || strcmp(name + len - 13, "_episodes.csv") != 0);
+}
+
+static int CompareReports(const void* a, const void* b)
+{
+  return strcmp(((const QaReport_t*)a)->path, ((const QaReport_t*)b)->path);
+}
+
+// Files are taken as given, directories contribute their .csv and .bin files.
+static int AddPath(QaReport_t* reports, int num_files, const char* path)
+{
+  struct stat st;
+  if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+  {
+    DIR* dir = opendir(path);
+    if (dir == NULL)
+    {
+      perror(path);
+      return num_files;
+    }
+    const int first = num_files;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL && num_files < MAX_FILES)
+      if (IsRecording(entry->d_name))
+        snprintf(reports[num_files++].path, sizeof(reports[0].path), "%s/%s", path, entry->d_name);
+    closedir(dir);
+    qsort(&reports[first], num_files - first, sizeof(QaReport_t), CompareReports);
+    return num_files;
+  }
+  if (num_files < MAX_FILES)
+    snprintf(reports[num_files++].path, sizeof(reports[0].path), "%s", path);
+  return num_files;
+}
+
+static void PrintReport(const QaReport_t* r)
+{
+  printf("%s: %s", r->path, r->pass ? "PASS" : "FAIL");
+  if (r->pass == false)
+    printf(" (%s)", r->failures);
+  printf("\n");
+  if (r->loaded == false || r->num_samples < 2)
+    return;
+  printf("  %zu samples, %.3f s, nominal %.1f Hz (%s)\n", r->num_samples, r->duration_s, r->odr_hz, r->odr_source);
+  printf("  interval us: mean %.2f std %.2f min %.2f max %.2f\n", r->interval_mean_us, r->interval_std_us,
+         r->interval_min_us, r->interval_max_us);
+  printf("  interval / period:");
+  for (int b = 0; b < NUM_INTERVAL_BINS; b++)
+    printf(" %s:%llu", kIntervalNames[b], (unsigned long long)r->interval_hist[b]);
+  printf("\n  gaps %llu (%llu samples missing, longest %.4f s), nonmonotonic %llu\n", (unsigned long long)r->gaps,
+         (unsigned long long)r->missing, r->longest_gap_s, (unsigned long long)r->nonmonotonic);
+  printf("  identical runs %llu (%llu repeated samples, longest %d)\n", (unsigned long long)r->identical_runs,
+         (unsigned long long)r->identical_samples, r->longest_identical_run);
+  printf("  saturated:");
+  for (int c = 0; c < RECORDING_CHANNELS; c++)
+    printf(" %s:%llu", kChannelNames[c], (unsigned long long)r->saturated[c]);
+  printf("\n  bad rows %zu, truncated end %s\n", r->bad_rows, r->truncated ? "yes" : "no");
+}
+
+static void JsonString(FILE* file, const char* str)
+{
+  fputc('"', file);
+  for (; *str; str++)
+  {
+    if (*str == '"' || *str == '\\')
+      fprintf(file, "\\%c", *str);
+    else if ((unsigned char)*str < 0x20)
+      fprintf(file, "\\u%04x", *str);
+    else
+      fputc(*str, file);
+  }
+  fputc('"', file);
+}
+
+// JSON has no inf or nan, those become null.
+static void JsonNumber(FILE* file, const char* format, double value)
+{
+  if (isfinite(value))
+    fprintf(file, format, value);
+  else
+    fprintf(file, "null");
+}
+
+static void WriteJson(FILE* file, const QaReport_t* reports, int num_files, int num_failed, double seconds)
+{
+  fprintf(file, "{\"files\": [");
+  for (int i = 0; i < num_files; i++)
+  {
+    const QaReport_t* r = &reports[i];
+    fprintf(file, "%s\n  {\"path\": ", i ? "," : "");
+    JsonString(file, r->path);
+    fprintf(file, ", \"pass\": %s, \"failures\": [", r->pass ? "true" : "false");
+    // Reasons are single words without quotes, so splitting the list is enough.
+    char failures[sizeof(r->failures)];
+    snprintf(failures, sizeof(failures), "%s", r->failures);
+    int k = 0;
+    for (char* save = NULL, *reason = strtok_r(failures, ",", &save); reason; reason = strtok_r(NULL, ",", &save))
+      fprintf(file, "%s\"%s\"", k++ ? ", " : "", reason);
+    fprintf(file, "]");
+    if (r->loaded && r->num_samples >= 2)
+    {
+      fprintf(file, ", \"samples\": %zu, \"duration_s\": ", r->num_samples);
+      JsonNumber(file, "%.6f", r->duration_s);
+      fprintf(file, ", \"odr_hz\": ");
+      JsonNumber(file, "%.3f", r->odr_hz);
+      fprintf(file, ", \"odr_source\": \"%s\", \"interval_us\": {\"mean\": ", r->odr_source);
+      JsonNumber(file, "%.3f", r->interval_mean_us);
+      fprintf(file, ", \"std\": ");
+      JsonNumber(file, "%.3f", r->interval_std_us);
+      fprintf(file, ", \"min\": ");
+      JsonNumber(file, "%.3f", r->interval_min_us);
+      fprintf(file, ", \"max\": ");
+      JsonNumber(file, "%.3f", r->interval_max_us);
+      fprintf(file, "}");
+      fprintf(file, ", \"interval_hist\": {");
+      for (int b = 0; b < NUM_INTERVAL_BINS; b++)
+        fprintf(file, "%s\"%s\": %llu", b ? ", " : "", kIntervalNames[b], (unsigned long long)r->interval_hist[b]);
+      fprintf(file, "}, \"gaps\": %llu, \"missing_samples\": %llu, \"longest_gap_s\": ", (unsigned long long)r->gaps,
+              (unsigned long long)r->missing);
+      JsonNumber(file, "%.6f", r->longest_gap_s);
+      fprintf(file, ", \"nonmonotonic\": %llu", (unsigned long long)r->nonmonotonic);
+      fprintf(file, ", \"identical_runs\": %llu, \"identical_samples\": %llu, \"longest_identical_run\": %d",
+              (unsigned long long)r->identical_runs, (unsigned long long)r->identical_samples,
+              r->longest_identical_run);
+      fprintf(file, ", \"saturated\": {");
+      for (int c = 0; c < RECORDING_CHANNELS; c++)
+        fprintf(file, "%s\"%s\": %llu", c ? ", " : "", kChannelNames[c], (unsigned long long)r->saturated[c]);
+      fprintf(file, "}, \"bad_rows\": %zu, \"truncated\": %s", r->bad_rows, r->truncated ? "true" : "false");
+    }
+    fprintf(file, "}");
+  }
+  fprintf(file, "\n], \"summary\": {\"files\": %d, \"passed\": %d, \"failed\": %d, \"seconds\": %.3f}}\n", num_files,
+          num_files - num_failed, num_failed, seconds);
+}
+
+static void PrintUsage(const char* argv0)
+{
+  printf("usage: %s [options] FILE_OR_DIR...\n"
+         "  -j, --threads N        worker threads (default: online cpus)\n"
+         "      --json PATH        machine readable report, - for stdout (then no text report)\n"
+         "      --odr HZ           nominal rate (default: # odr_hz line, else the median step)\n"
+         "      --max-missing PCT  samples lost in gaps (default 0.1)\n"
+         "      --max-jitter PCT   intervals outside 0.5..1.5 periods (default 1)\n"
+         "      --max-run N        longest run of identical samples (default 4)\n"
+         "      --max-saturated PCT values at full scale (default 0.1)\n"
+         "  -q, --quiet            only print failing files\n"
+         "  -h, --help\n",
+         argv0);
+}
+
+enum {
+  kOptJson = 256,
+  kOptOdr,
+  kOptMaxMissing,
+  kOptMaxJitter,
+  kOptMaxRun,
+  kOptMaxSaturated,
+};
+
+int main(int argc, char** argv)
+{
+  QaLimits_t limits = {
+      .odr_hz = 0,
+      .max_missing_pct = 0.1,
+      .max_off_pct = 1,
+      .max_saturated_pct = 0.1,
+      .max_identical_run = 4,
+  };
+  int num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  const char* json_path = NULL;
+  bool quiet = false;
+  static const struct option kLongOptions[] = {
+      {"threads", required_argument, NULL, 'j'},
+      {"json", required_argument, NULL, kOptJson},
+      {"odr", required_argument, NULL, kOptOdr},
+      {"max-missing", required_argument, NULL, kOptMaxMissing},
+      {"max-jitter", required_argument, NULL, kOptMaxJitter},
+      {"max-run", required_argument, NULL, kOptMaxRun},
+      {"max-saturated", required_argument, NULL, kOptMaxSaturated},
+      {"quiet", no_argument, NULL, 'q'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "j:qh", kLongOptions, NULL)) != -1)
+  {
+    switch (opt)
+    {
+    case 'j':
+      num_threads = atoi(optarg);
+      break;
+    case kOptJson:
+      json_path = optarg;
+      break;
+    case kOptOdr:
+      limits.odr_hz = atof(optarg);
+      break;
+    case kOptMaxMissing:
+      limits.max_missing_pct = atof(optarg);
+      break;
+    case kOptMaxJitter:
+      limits.max_off_pct = atof(optarg);
+      break;
+    case kOptMaxRun:
+      limits.max_identical_run = atoi(optarg);
+      break;
+    case kOptMaxSaturated:
+      limits.max_saturated_pct = atof(optarg);
+      break;
+    case 'q':
+      quiet = true;
+      break;
+    case 'h':
+      PrintUsage(argv[0]);
+      return 0;
+    default:
+      PrintUsage(argv[0]);
+      return 2;
+    }
+  }
+  if (optind >= argc || num_threads < 1)
+  {
+    PrintUsage(argv[0]);
+    return 2;
+  }
+
+  static QaReport_t reports[MAX_FILES];
+  int num_files = 0;
+  for (int i = optind; i < argc; i++)
+    num_files = AddPath(reports, num_files, argv[i]);
+
+  Job_t job = {.reports = reports, .num_files = num_files, .limits = &limits};
+  atomic_init(&job.next_file, 0);
+  if (num_threads > num_files)
+    num_threads = num_files > 0 ? num_files : 1;
+  pthread_t threads[num_threads];
+  double start = NowSeconds();
+  for (int t = 0; t < num_threads; t++)
+    pthread_create(&threads[t], NULL, Worker, &job);
+  for (int t = 0; t < num_threads; t++)
+    pthread_join(threads[t], NULL);
+  double seconds = NowSeconds() - start;
+
+  int num_failed = 0;
+  for (int i = 0; i < num_files; i++)
+    num_failed += reports[i].pass == false;
+
+  const bool json_stdout = json_path != NULL && strcmp(json_path, "-") == 0;
+  if (json_stdout == false)
+  {
+    for (int i = 0; i < num_files; i++)
+      if (quiet == false || reports[i].pass == false)
+        PrintReport(&reports[i]);
+    printf("%d files, %d passed, %d failed in %.3f s on %d threads\n", num_files, num_files - num_failed, num_failed,
+           seconds, num_threads);
+  }
+  if (json_path != NULL)
+  {
+    FILE* file = json_stdout ? stdout : fopen(json_path, "w");
+    if (file == NULL)
+    {
+      perror(json_path);
+      return 2;
+    }
+    WriteJson(file, reports, num_files, num_failed, seconds);
+    if (file != stdout)
+      fclose(file);
+  }
+  return num_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+#include "npy.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int NpyWrite(const char* path, const char* dtype, size_t element_size, const void* data, size_t rows, size_t cols)
+{
+  char header[256];
+  int len;
+  if (cols == 0)
+    len = snprintf(header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': (%zu,), }", dtype, rows);
+  else
+    len = snprintf(header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': (%zu, %zu), }", dtype,
+                   rows, cols);
+  // Magic, version and length take 10 bytes. The header is space padded so the data starts 64 byte aligned.
+  int total = 10 + len + 1;
+  int padded = (total + 63) / 64 * 64;
+  memset(header + len, ' ', padded - total);
+  len += padded - total;
+  header[len++] = '\n';
+
+  FILE* file = fopen(path, "wb");
+  if (file == NULL)
+    return -1;
+  const unsigned char preamble[10] = {0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0, len & 0xff, len >> 8};
+  size_t count = rows * (cols ? cols : 1);
+  int ok = fwrite(preamble, 1, sizeof(preamble), file) == sizeof(preamble) &&
+           fwrite(header, 1, len, file) == (size_t)len && fwrite(data, element_size, count, file) == count;
+  ok = fclose(file) == 0 && ok;
+  return ok ? 0 : -1;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stddef.h>
+
+// Write a C-order .npy (format 1.0) that numpy.load() reads directly.
+// dtype is the numpy descr, e.g. "<f4" or "<i4". Returns 0 on success, -1 and errno otherwise.
+int NpyWrite(const char* path, const char* dtype, size_t element_size, const void* data, size_t rows, size_t cols);
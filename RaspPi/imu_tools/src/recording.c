@@ -0,0 +1,269 @@
+#include "recording.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Whole file in one allocation, parsing from memory is much faster than fgets.
+static char* ReadFile(const char* path, size_t* size)
+{
+  FILE* file = fopen(path, "rb");
+  if (file == NULL)
+    return NULL;
+  fseek(file, 0, SEEK_END);
+  long len = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char* data = malloc(len + 1);
+  if (data != NULL && fread(data, 1, len, file) != (size_t)len)
+  {
+    free(data);
+    data = NULL;
+  }
+  fclose(file);
+  if (data != NULL)
+  {
+    data[len] = '\0';
+    *size = len;
+  }
+  return data;
+}
+
+static void ParseMeta(Recording_t* rec, const char* line, const char* end)
+{
+  // "# key=value"
+  line++;
+  while (line < end && *line == ' ')
+    line++;
+  const char* equals = memchr(line, '=', end - line);
+  if (equals == NULL || rec->num_meta == 64)
+    return;
+  int key_len = equals - line, value_len = end - equals - 1;
+  if (value_len > 0 && equals[value_len] == '\r')
+    value_len--;
+  if (key_len >= 32 || value_len >= 64)
+    return;
+  memcpy(rec->meta_keys[rec->num_meta], line, key_len);
+  rec->meta_keys[rec->num_meta][key_len] = '\0';
+  memcpy(rec->meta_values[rec->num_meta], equals + 1, value_len);
+  rec->meta_values[rec->num_meta][value_len] = '\0';
+  rec->num_meta++;
+}
+
+static void RecordingAlloc(Recording_t* rec, size_t capacity)
+{
+  rec->t = malloc(sizeof(double) * capacity);
+  for (int c = 0; c < RECORDING_CHANNELS; c++)
+    rec->ch[c] = malloc(sizeof(float) * capacity);
+}
+
+static bool HasSuffix(const char* str, const char* suffix)
+{
+  size_t len = strlen(str), suffix_len = strlen(suffix);
+  return len >= suffix_len && strcmp(str + len - suffix_len, suffix) == 0;
+}
+
+// Trailer counters in Pico ImuReadStats order.
+static const char* const kPicoStatsKeys[] = {"samples", "empty_reads", "duplicates", "invalid",
+                                             "gaps", "fifo_overflows", "dropped"};
+
+// Fixed size little endian records, a trailing partial record is a cut-off write.
+static void ParsePico(Recording_t* rec, const char* data, size_t size)
+{
+  const size_t num_records = size / RECORDING_PICO_RECORD_SIZE;
+  RecordingAlloc(rec, num_records ? num_records : 1);
+  rec->num_columns = 1 + RECORDING_CHANNELS;
+  rec->truncated = size % RECORDING_PICO_RECORD_SIZE != 0;
+  size_t n = 0;
+  for (size_t i = 0; i < num_records; i++)
+  {
+    const char* record = data + i * RECORDING_PICO_RECORD_SIZE;
+    uint64_t t;
+    int16_t values[RECORDING_CHANNELS];
+    memcpy(&t, record, sizeof(t));
+    memcpy(values, record + sizeof(t), sizeof(values));
+    const uint64_t stat = t & ~RECORDING_PICO_STATS_FLAG;
+    if ((t & RECORDING_PICO_STATS_FLAG) == RECORDING_PICO_STATS_FLAG &&
+        stat < sizeof(kPicoStatsKeys) / sizeof(kPicoStatsKeys[0]))
+    {
+      char line[64];
+      int len = snprintf(line, sizeof(line), "# %s=%u", kPicoStatsKeys[stat],
+                         (uint16_t)values[0] | (uint32_t)(uint16_t)values[1] << 16);
+      ParseMeta(rec, line, line + len);
+    }
+    if (t & RECORDING_PICO_LABEL_FLAG)
+      continue;
+    rec->t[n] = t;
+    for (int c = 0; c < RECORDING_CHANNELS; c++)
+      rec->ch[c][n] = values[c];
+    n++;
+  }
+  rec->num_samples = n;
+}
+
+int RecordingLoad(Recording_t* rec, const char* path)
+{
+  memset(rec, 0, sizeof(*rec));
+  size_t size;
+  char* data = ReadFile(path, &size);
+  if (data == NULL)
+  {
+    perror(path);
+    return -1;
+  }
+  if (HasSuffix(path, ".bin"))
+  {
+    ParsePico(rec, data, size);
+    free(data);
+    return 0;
+  }
+  rec->truncated = size > 0 && data[size - 1] != '\n';
+
+  // Upper bound on rows, one per newline.
+  size_t capacity = 1;
+  for (size_t i = 0; i < size; i++)
+    capacity += data[i] == '\n';
+  RecordingAlloc(rec, capacity);
+
+  for (char* line = data; line < data + size;)
+  {
+    char* end = memchr(line, '\n', data + size - line);
+    if (end == NULL)
+      end = data + size;
+    *end = '\0';
+
+    if (line[0] == '#')
+    {
+      ParseMeta(rec, line, end);
+    }
+    else if (end > line)
+    {
+      // Fields are "number, number, ...". Rows without a numeric time (the header) are skipped.
+      double values[1 + RECORDING_CHANNELS];
+      int num_fields = 0;
+      bool all_numeric = true;
+      char* field = line;
+      while (field < end)
+      {
+        char* parse_end;
+        double value = strtod(field, &parse_end);
+        while (*parse_end == ' ' || *parse_end == '\t' || *parse_end == '\r')
+          parse_end++;
+        bool numeric = parse_end != field && (*parse_end == ',' || parse_end == end);
+        all_numeric = all_numeric && numeric;
+        if (num_fields < 1 + RECORDING_CHANNELS)
+          values[num_fields] = numeric ? value : NAN;
+        num_fields++;
+        char* comma = memchr(field, ',', end - field);
+        if (comma == NULL)
+          break;
+        field = comma + 1;
+      }
+      if (num_fields > rec->num_columns)
+        rec->num_columns = num_fields;
+      if (num_fields > 0 && isnan(values[0]) == false)
+      {
+        size_t n = rec->num_samples++;
+        rec->num_bad_rows += all_numeric == false || num_fields < 1 + RECORDING_CHANNELS;
+        rec->t[n] = values[0];
+        for (int c = 0; c < RECORDING_CHANNELS; c++)
+          rec->ch[c][n] = c + 1 < num_fields ? values[c + 1] : NAN;
+      }
+    }
+    line = end + 1;
+  }
+
+  free(data);
+  return 0;
+}
+
+void RecordingFree(Recording_t* rec)
+{
+  free(rec->t);
+  for (int c = 0; c < RECORDING_CHANNELS; c++)
+    free(rec->ch[c]);
+  memset(rec, 0, sizeof(*rec));
+}
+
+const char* RecordingMeta(const Recording_t* rec, const char* key)
+{
+  for (int i = 0; i < rec->num_meta; i++)
+    if (strcmp(rec->meta_keys[i], key) == 0)
+      return rec->meta_values[i];
+  return NULL;
+}
+
+static int CompareDoubles(const void* a, const void* b)
+{
+  double da = *(const double*)a, db = *(const double*)b;
+  return (da > db) - (da < db);
+}
+
+double RecordingMedianStep(const Recording_t* rec)
+{
+  if (rec->num_samples < 2)
+    return 0;
+  double* sorted = malloc(sizeof(double) * rec->num_samples);
+  if (sorted == NULL)
+    return 0;
+  memcpy(sorted, rec->t, sizeof(double) * rec->num_samples);
+  qsort(sorted, rec->num_samples, sizeof(double), CompareDoubles);
+  // Steps between distinct times, written over the front of sorted.
+  size_t n = 0;
+  for (size_t i = 1; i < rec->num_samples; i++)
+    if (sorted[i] > sorted[i - 1])
+      sorted[n++] = sorted[i] - sorted[i - 1];
+  double median = 0;
+  if (n > 0)
+  {
+    qsort(sorted, n, sizeof(double), CompareDoubles);
+    median = n % 2 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+  }
+  free(sorted);
+  return median;
+}
+
+double RecordingTimeScale(const Recording_t* rec)
+{
+  const double median = RecordingMedianStep(rec);
+  if (median > 10)
+    return 1e-6;
+  if (median > 0.01)
+    return 1e-3;
+  return 1;
+}
+
+void RecordingClassFromPath(const char* path, char* label, size_t size)
+{
+  const char* name = strrchr(path, '/');
+  name = name ? name + 1 : path;
+  char stem[256];
+  snprintf(stem, sizeof(stem), "%s", name);
+  char* dot = strrchr(stem, '.');
+  if (dot)
+    *dot = '\0';
+  for (int pass = 0; pass < 2; pass++)
+  {
+    char* underscore = strrchr(stem, '_');
+    if (underscore == NULL)
+      break;
+    const char* digits = underscore + 1 + (strncmp(underscore + 1, "ep", 2) == 0 ? 2 : 0);
+    if (*digits == '\0' || strspn(digits, "0123456789") != strlen(digits))
+      break;
+    *underscore = '\0';
+  }
+
+  char* dash = strchr(stem, '-');
+  if (dash == NULL)
+  {
+    snprintf(label, size, "%s", stem);
+    return;
+  }
+  char* part = dash + 1;
+  char* next = strchr(part, '-');
+  if (next)
+    *next = '\0';
+  snprintf(label, size, "%s Grit", part);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Channels after the time column, in file order: ax, ay, az, gx, gy, gz.
+#define RECORDING_CHANNELS 6
+
+// Size of one sample in a Pico binary stream (CollectImuData.c or imu_usb_reader --out): uint64 t in
+// microseconds, ax..gz as int16, 4 bytes of padding.
+#define RECORDING_PICO_RECORD_SIZE 24
+// Set in t for the label records of a classifier build (Pico/imu_classifier.h), skipped on load.
+#define RECORDING_PICO_LABEL_FLAG (1ull << 63)
+// Set in t for the stats trailer that ends a Pico recording (Pico/imu_core.h), loaded as "# key=value"
+// meta with the recorder's names: one record per counter, value in ax (low half) and ay (high half).
+#define RECORDING_PICO_STATS_FLAG (3ull << 62)
+
+// One recording loaded into memory. Values are the raw counts as written, empty or
+// non-numeric fields become NaN.
+typedef struct {
+  size_t num_samples;
+  int num_columns;                // Columns in the widest row, 7 for a plain recording.
+  size_t num_bad_rows;            // Rows with a time but missing or non-numeric fields, e.g. a cut-off line.
+  bool truncated;                 // Last line without a newline, or a partial binary record.
+  double* t;                      // Time column as written, units vary between recordings.
+  float* ch[RECORDING_CHANNELS];  // Raw counts, exact for int16.
+
+  // "# key=value" lines from the recorder.
+  int num_meta;
+  char meta_keys[64][32];
+  char meta_values[64][64];
+} Recording_t;
+
+// Load a recorder csv, or a Pico binary stream if the name ends in ".bin" (time in microseconds).
+// Returns 0 on success, prints the problem and returns -1 otherwise.
+int RecordingLoad(Recording_t* rec, const char* path);
+void RecordingFree(Recording_t* rec);
+// Value of a "# key=value" line, NULL if absent.
+const char* RecordingMeta(const Recording_t* rec, const char* key);
+// Median step between distinct times, in time column units, like median(diff(unique(t))).
+// Duplicated samples don't pull it to 0. Returns 0 with fewer than two distinct times.
+double RecordingMedianStep(const Recording_t* rec);
+// Seconds per unit of the time column, guessed from RecordingMedianStep() like processData.m:
+// steps above 10 are microseconds, above 0.01 milliseconds, otherwise seconds.
+double RecordingTimeScale(const Recording_t* rec);
+// Class from the file name like processData.m: "sandpaper-120-grit" is "120 Grit". The recorder's
+// "_NNN" session number and "_epNNN" episode number are stripped first.
+void RecordingClassFromPath(const char* path, char* label, size_t size);
@@ -0,0 +1,326 @@
+#include "window_features.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "recording.h"
+
+const FeatureParams_t kDefaultFeatureParams = {
+    .target_fs = 1000,
+    .window_s = 0.2,
+    .hop_s = 0.05,
+    .gravity_window_s = 0.5,
+    .crop_s = 0.5,
+};
+
+void FeatureExtractorInit(FeatureExtractor_t* ext, const FeatureParams_t* params)
+{
+  ext->params = *params;
+  ext->blocksize = lround(params->window_s * params->target_fs);
+  ext->hop = lround(params->hop_s * params->target_fs);
+  ext->num_bins = ext->blocksize / 2 + 1;
+  ext->cos_table = malloc(sizeof(double) * ext->num_bins * ext->blocksize);
+  ext->sin_table = malloc(sizeof(double) * ext->num_bins * ext->blocksize);
+  ext->seg = malloc(sizeof(double) * FEATURE_SIGNALS * ext->blocksize);
+  for (int k = 0; k < ext->num_bins; k++)
+  {
+    for (int n = 0; n < ext->blocksize; n++)
+    {
+      double angle = 2 * M_PI * (double)((long)k * n % ext->blocksize) / ext->blocksize;
+      ext->cos_table[k * ext->blocksize + n] = cos(angle);
+      ext->sin_table[k * ext->blocksize + n] = sin(angle);
+    }
+  }
+}
+
+void FeatureExtractorFree(FeatureExtractor_t* ext)
+{
+  free(ext->cos_table);
+  free(ext->sin_table);
+  free(ext->seg);
+  memset(ext, 0, sizeof(*ext));
+}
+
+typedef struct {
+  double t;
+  size_t index;
+} TimeIndex_t;
+
+static int CompareTimeIndex(const void* a, const void* b)
+{
+  const TimeIndex_t *ta = a, *tb = b;
+  if (ta->t != tb->t)
+    return (ta->t > tb->t) - (ta->t < tb->t);
+  return (ta->index > tb->index) - (ta->index < tb->index);
+}
+
+// fillmissing(x, "linear"): interpolate NaN runs by row, extrapolate the ends from the two nearest valid points.
+static void FillMissing(double* x, size_t n)
+{
+  size_t valid[2] = {n, n}; // Second to last and last valid index so far.
+  size_t first = n, second = n;
+  for (size_t i = 0; i < n; i++)
+  {
+    if (isnan(x[i]))
+      continue;
+    size_t prev = valid[1];
+    if (prev != n)
+      for (size_t j = prev + 1; j < i; j++)
+        x[j] = x[prev] + (x[i] - x[prev]) * (double)(j - prev) / (i - prev);
+    valid[0] = valid[1];
+    valid[1] = i;
+    if (first == n)
+      first = i;
+    else if (second == n)
+      second = i;
+  }
+  if (first == n)
+  {
+    memset(x, 0, sizeof(double) * n);
+    return;
+  }
+  for (size_t j = 0; j < first; j++)
+    x[j] = second == n ? x[first] : x[first] - (x[second] - x[first]) * (double)(first - j) / (second - first);
+  const size_t last = valid[1], before = valid[0];
+  for (size_t j = last + 1; j < n; j++)
+    x[j] = before == n ? x[last] : x[last] + (x[last] - x[before]) * (double)(j - last) / (last - before);
+}
+
+// Free the channels allocated so far, after a failed malloc.
+static void FreeChannels(double* channels[RECORDING_CHANNELS], int num_channels)
+{
+  for (int c = 0; c < num_channels; c++)
+    free(channels[c]);
+}
+
+size_t FeatureResample(const Recording_t* rec, const FeatureParams_t* params, double* resampled[RECORDING_CHANNELS])
+{
+  const size_t num_raw = rec->num_samples;
+  if (num_raw < 2)
+    return 0;
+
+  // unique(): sorted, first occurrence of each time kept.
+  TimeIndex_t* order = malloc(sizeof(TimeIndex_t) * num_raw);
+  if (order == NULL)
+  {
+    fprintf(stderr, "Out of memory sorting %zu samples\n", num_raw);
+    return 0;
+  }
+  for (size_t i = 0; i < num_raw; i++)
+    order[i] = (TimeIndex_t){rec->t[i], i};
+  qsort(order, num_raw, sizeof(TimeIndex_t), CompareTimeIndex);
+  size_t n = 0;
+  for (size_t i = 0; i < num_raw; i++)
+    if (n == 0 || order[i].t != order[n - 1].t)
+      order[n++] = order[i];
+
+  const double scale = RecordingTimeScale(rec);
+  double* t = malloc(sizeof(double) * n);
+  double* x = malloc(sizeof(double) * n);
+  if (t == NULL || x == NULL)
+  {
+    fprintf(stderr, "Out of memory sorting %zu samples\n", num_raw);
+    free(order);
+    free(t);
+    free(x);
+    return 0;
+  }
+  for (size_t i = 0; i < n; i++)
+    t[i] = (order[i].t - order[0].t) * scale;
+
+  // Uniform grid 0:1/fs:t(end), linear interp1 with extrapolation.
+  const double fs = params->target_fs;
+  const size_t num_uniform = n < 2 ? 0 : (size_t)floor(t[n - 1] * fs + 1e-9) + 1;
+  int num_channels = 0;
+  for (int c = 0; c < RECORDING_CHANNELS && num_uniform >= 2; c++)
+  {
+    for (size_t i = 0; i < n; i++)
+      x[i] = rec->ch[c][order[i].index];
+    FillMissing(x, n);
+
+    resampled[c] = malloc(sizeof(double) * num_uniform);
+    if (resampled[c] == NULL)
+    {
+      // A time column in the wrong units asks for years of samples.
+      fprintf(stderr, "Out of memory resampling %.0f s of data to %.0f Hz\n", t[n - 1], fs);
+      FreeChannels(resampled, num_channels);
+      num_channels = 0;
+      break;
+    }
+    num_channels++;
+    size_t seg = 0;
+    for (size_t i = 0; i < num_uniform; i++)
+    {
+      double tu = i / fs;
+      while (seg + 2 < n && t[seg + 1] <= tu)
+        seg++;
+      resampled[c][i] = x[seg] + (x[seg + 1] - x[seg]) * (tu - t[seg]) / (t[seg + 1] - t[seg]);
+    }
+  }
+
+  free(order);
+  free(t);
+  free(x);
+  return num_channels == RECORDING_CHANNELS ? num_uniform : 0;
+}
+
+size_t FeaturePreprocess(const Recording_t* rec, const FeatureParams_t* params, double* clean[RECORDING_CHANNELS])
+{
+  double* resampled[RECORDING_CHANNELS];
+  const size_t num_uniform = FeatureResample(rec, params, resampled);
+  if (num_uniform == 0)
+    return 0;
+
+  const double fs = params->target_fs;
+  const size_t gravity_k = lround(params->gravity_window_s * fs);
+  // Like MATLAB, a recording shorter than the crop is kept whole.
+  size_t crop = lround(params->crop_s * fs);
+  if (num_uniform <= crop)
+    crop = 0;
+  const size_t num_clean = num_uniform - crop;
+  double* prefix = malloc(sizeof(double) * (num_uniform + 1));
+  for (int c = 0; c < RECORDING_CHANNELS; c++)
+    clean[c] = prefix != NULL ? malloc(sizeof(double) * num_clean) : NULL;
+  for (int c = 0; c < RECORDING_CHANNELS; c++)
+  {
+    if (clean[c] == NULL)
+    {
+      fprintf(stderr, "Out of memory removing gravity from %zu samples\n", num_uniform);
+      free(prefix);
+      FreeChannels(resampled, RECORDING_CHANNELS);
+      FreeChannels(clean, RECORDING_CHANNELS);
+      return 0;
+    }
+  }
+
+  for (int c = 0; c < RECORDING_CHANNELS; c++)
+  {
+    // movmean(x, k) with shrinking ends, window [i - floor(k/2), i + ceil(k/2) - 1].
+    prefix[0] = 0;
+    for (size_t i = 0; i < num_uniform; i++)
+      prefix[i + 1] = prefix[i] + resampled[c][i];
+    for (size_t i = crop; i < num_uniform; i++)
+    {
+      size_t lo = i >= gravity_k / 2 ? i - gravity_k / 2 : 0;
+      size_t hi = i + (gravity_k + 1) / 2; // Exclusive.
+      if (hi > num_uniform)
+        hi = num_uniform;
+      clean[c][i - crop] = resampled[c][i] - (prefix[hi] - prefix[lo]) / (hi - lo);
+    }
+    free(resampled[c]);
+  }
+
+  free(prefix);
+  return num_clean;
+}
+
+// Mean, variance, rms, range, peak frequency, mean power, peak power and spectral entropy of one signal.
+static void SignalFeatures(const FeatureExtractor_t* ext, const double* seg, float* out)
+{
+  const int n = ext->blocksize;
+  double sum = 0, sum_sq = 0, min = seg[0], max = seg[0];
+  for (int i = 0; i < n; i++)
+  {
+    sum += seg[i];
+    sum_sq += seg[i] * seg[i];
+    min = seg[i] < min ? seg[i] : min;
+    max = seg[i] > max ? seg[i] : max;
+  }
+  double mean = sum / n;
+  double var = 0;
+  for (int i = 0; i < n; i++)
+    var += (seg[i] - mean) * (seg[i] - mean);
+  var /= n - 1;
+
+  // Single-sided amplitude spectrum, P1 in processData.m.
+  double power_sum = 0, max_p = -1;
+  int max_k = 0;
+  double power[ext->num_bins];
+  for (int k = 0; k < ext->num_bins; k++)
+  {
+    const double *cos_k = &ext->cos_table[k * n], *sin_k = &ext->sin_table[k * n];
+    double re = 0, im = 0;
+    for (int i = 0; i < n; i++)
+    {
+      re += seg[i] * cos_k[i];
+      im += seg[i] * sin_k[i];
+    }
+    double p = sqrt(re * re + im * im) / n;
+    if (k > 0 && k < ext->num_bins - 1)
+      p *= 2;
+    if (p > max_p)
+    {
+      max_p = p;
+      max_k = k;
+    }
+    power[k] = p * p;
+    power_sum += power[k];
+  }
+  const double mean_power = power_sum / ext->num_bins;
+  if (power_sum == 0)
+    power_sum = DBL_EPSILON;
+  double entropy = 0;
+  for (int k = 0; k < ext->num_bins; k++)
+  {
+    double prob = power[k] / power_sum;
+    if (prob == 0)
+      prob = DBL_EPSILON;
+    entropy -= prob * log2(prob);
+  }
+
+  out[0] = mean;
+  out[1] = var;
+  out[2] = sqrt(sum_sq / n);
+  out[3] = max - min;
+  out[4] = ext->params.target_fs * max_k / n;
+  out[5] = mean_power;
+  out[6] = max_p * max_p;
+  out[7] = entropy;
+}
+
+size_t FeatureExtract(FeatureExtractor_t* ext, double* const clean[RECORDING_CHANNELS], size_t n, float** features)
+{
+  const int block = ext->blocksize;
+  *features = NULL;
+  if (n < (size_t)block)
+    return 0;
+  const size_t num_windows = (n - block) / ext->hop + 1;
+  *features = malloc(sizeof(float) * FEATURE_COUNT * num_windows);
+  if (*features == NULL)
+    return 0;
+
+  for (size_t w = 0; w < num_windows; w++)
+  {
+    const size_t start = w * ext->hop;
+    // Signals in MATLAB order: Ax, Ay, Az, SMV_Acc, Gx, Gy, Gz, SMV_Gyr.
+    double* seg = ext->seg;
+    for (int i = 0; i < block; i++)
+    {
+      for (int axis = 0; axis < 3; axis++)
+      {
+        seg[axis * block + i] = clean[axis][start + i];
+        seg[(4 + axis) * block + i] = clean[3 + axis][start + i];
+      }
+      seg[3 * block + i] = sqrt(clean[0][start + i] * clean[0][start + i] + clean[1][start + i] * clean[1][start + i] +
+                                clean[2][start + i] * clean[2][start + i]);
+      seg[7 * block + i] = sqrt(clean[3][start + i] * clean[3][start + i] + clean[4][start + i] * clean[4][start + i] +
+                                clean[5][start + i] * clean[5][start + i]);
+    }
+    for (int s = 0; s < FEATURE_SIGNALS; s++)
+      SignalFeatures(ext, &seg[s * block], &(*features)[w * FEATURE_COUNT + s * FEATURES_PER_SIGNAL]);
+  }
+  return num_windows;
+}
+
+void FeatureNames(char names[FEATURE_COUNT][24])
+{
+  static const char* kSignals[FEATURE_SIGNALS] = {"Ax", "Ay", "Az", "SMV_Acc", "Gx", "Gy", "Gz", "SMV_Gyr"};
+  static const char* kFeatures[FEATURES_PER_SIGNAL] = {"mean", "var", "rms", "range",
+                                                       "peakFreq", "meanPower", "peakPower", "specEnt"};
+  for (int s = 0; s < FEATURE_SIGNALS; s++)
+    for (int f = 0; f < FEATURES_PER_SIGNAL; f++)
+      snprintf(names[s * FEATURES_PER_SIGNAL + f], 24, "%s_%s", kSignals[s], kFeatures[f]);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "recording.h"
+
+// 8 signals (ax, ay, az, |a|, gx, gy, gz, |g|) times 8 features, ordered signal major like processData.m.
+#define FEATURE_SIGNALS 8
+#define FEATURES_PER_SIGNAL 8
+#define FEATURE_COUNT (FEATURE_SIGNALS * FEATURES_PER_SIGNAL)
+
+typedef struct {
+  double target_fs;        // Resample rate, Hz.
+  double window_s;         // Feature window.
+  double hop_s;            // Window step.
+  double gravity_window_s; // Moving mean subtracted to remove gravity.
+  double crop_s;           // Startup transient dropped after gravity removal.
+} FeatureParams_t;
+
+// Same values as processData.m.
+extern const FeatureParams_t kDefaultFeatureParams;
+
+// Per-thread state, the DFT tables for one window length.
+typedef struct {
+  FeatureParams_t params;
+  int blocksize, hop, num_bins;
+  double* cos_table; // [num_bins][blocksize]
+  double* sin_table;
+  double* seg;       // [FEATURE_SIGNALS][blocksize] scratch.
+} FeatureExtractor_t;
+
+void FeatureExtractorInit(FeatureExtractor_t* ext, const FeatureParams_t* params);
+void FeatureExtractorFree(FeatureExtractor_t* ext);
+
+// Sort and dedupe time, fill NaNs and resample linearly to target_fs, the first half of preprocessIMU().
+// Returns the sample count, resampled[c] is malloc'd. 0 if too short or out of memory.
+size_t FeatureResample(const Recording_t* rec, const FeatureParams_t* params, double* resampled[RECORDING_CHANNELS]);
+// preprocessIMU(): sort and dedupe time, fill NaNs, resample linearly to target_fs, subtract the
+// moving mean and crop the start. Returns the sample count, clean[c] is malloc'd. 0 if too short
+// or out of memory.
+size_t FeaturePreprocess(const Recording_t* rec, const FeatureParams_t* params, double* clean[RECORDING_CHANNELS]);
+// extractIMUFeatures(): returns the window count and a malloc'd [windows][FEATURE_COUNT] matrix.
+size_t FeatureExtract(FeatureExtractor_t* ext, double* const clean[RECORDING_CHANNELS], size_t n, float** features);
+// Column names like "Ax_mean", same as the MATLAB table.
+void FeatureNames(char names[FEATURE_COUNT][24]);